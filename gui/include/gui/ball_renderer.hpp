@@ -0,0 +1,202 @@
+#ifndef __BALL_RENDERER_HPP__
+#define __BALL_RENDERER_HPP__
+
+#include <SFML/OpenGL.hpp>  // the GL 2.0+ entry points need GL_GLEXT_PROTOTYPES, defined by the build
+#include <algorithm>  // std::max
+#include <cstdio>  // std::sscanf
+#include <cstring>  // std::strcmp
+#include <memory>  // std::unique_ptr
+#include <span>
+#include <vector>
+#include "count_texture.hpp"
+#include "point_bins.hpp"
+#include "view_program.hpp"
+#include "physics/vec2.hpp"
+
+// Retained-mode renderer for the balls
+// The positions (contiguous doubles, see World::positions()) are uploaded relative to the corner of the view into
+// a vertex buffer, mapped to clip space by the ViewProgram shaders, and drawn with a single glDrawArrays(GL_POINTS)
+// per frame.
+//
+// With GL 4.4 (or ARB_buffer_storage) the buffer is persistently mapped and split into NREGIONS regions written
+// in turn, each guarded by a fence, so that the CPU does not wait for the GPU to release the data it overwrites.
+// Otherwise the buffer is orphaned and refilled every frame, which works on any GL 2.1 context (e.g. Mesa llvmpipe).
+//
+// Level of detail: from lod_threshold balls per pixel of the viewport on, the balls are instead counted per pixel
+// on the CPU (PointBins) and only the counts are uploaded (CountTexture). Pixels holding a ball are drawn
+// the same way in both paths, so the switch does not show.
+//
+// The renderer must be created, used and destroyed while a GL context sharing its objects is active.
+
+class BallRenderer {
+public:
+	static constexpr unsigned int NREGIONS = 3;
+	static constexpr double LOD_THRESHOLD = 1;  // balls per pixel
+
+	// persistent mapping is only used if `allow_persistent` and the context supports it
+	explicit BallRenderer(bool allow_persistent = true) {
+		persistent = allow_persistent && has_buffer_storage();
+		glGenBuffers(1, &vbo);
+	}
+
+	~BallRenderer() {
+		release_mapping();
+		glDeleteBuffers(1, &vbo);
+	}
+
+	BallRenderer(BallRenderer const&) = delete;
+	BallRenderer& operator=(BallRenderer const&) = delete;
+
+	void set_color(float r, float g, float b, float a = 1) { color[0] = r; color[1] = g; color[2] = b; color[3] = a; }
+	void set_point_size(float size) { point_size = size; }
+	// balls per pixel from which they are binned instead of drawn one by one (infinity disables the binning)
+	void set_lod_threshold(double balls_per_pixel) { lod_threshold = balls_per_pixel; }
+	bool persistent_mapping() const { return persistent; }
+	// the last draw binned the balls
+	bool binned() const { return binned_; }
+
+	// draws the balls at `positions`, the view [view_min, view_max] (world coordinates) spanning the viewport
+	void draw(std::span<vec2 const> positions, vec2 const& view_min, vec2 const& view_max) {
+		if (positions.empty())
+			return;
+		size_t n(positions.size());
+		// binning only reproduces 1 pixel points
+		GLint viewport[4];
+		glGetIntegerv(GL_VIEWPORT, viewport);
+		binned_ = point_size == 1 && n >= lod_threshold * viewport[2] * viewport[3];
+		if (binned_) {
+			if (!bins) {
+				bins = std::make_unique<PointBins>();
+				counts = std::make_unique<CountTexture>();
+			}
+			bins->bin(positions, view_min, view_max, viewport[2], viewport[3]);
+			counts->draw(bins->counts(), bins->width(), bins->height(), color);
+			return;
+		}
+
+		size_t offset(persistent ? upload_persistent(positions, view_min) : upload_orphan(positions, view_min));
+
+		program.use(view_min, view_max, view_min, color);
+		glPointSize(point_size);
+		ViewProgram::attribute(offset);
+		glDrawArrays(GL_POINTS, 0, n);
+
+		if (persistent) {
+			fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+			region = (region + 1) % NREGIONS;
+		}
+		ViewProgram::release();
+	}
+
+	// draws the balls with the world coordinates [0, width]x[0, height] spanning the viewport
+	void draw(std::span<vec2 const> positions, double width, double height) {
+		draw(positions, vec2(0, 0), vec2(width, height));
+	}
+
+private:
+	ViewProgram program;
+	GLuint vbo = 0;
+	GLfloat color[4] = {0, 1, 0.5, 1};
+	float point_size = 1;
+	double lod_threshold = LOD_THRESHOLD;
+	bool binned_ = false;
+	std::unique_ptr<PointBins> bins;  // created by the first binned draw
+	std::unique_ptr<CountTexture> counts;
+	std::vector<vec2> staging;  // relative positions of the orphaning upload
+
+	bool persistent = false;
+	size_t capacity = 0;  // balls per region (persistent) or in the buffer (orphaning)
+	void* mapped = nullptr;
+	GLsync fences[NREGIONS] = {};
+	unsigned int region = 0;
+
+	// glBufferStorage and fences are available
+	static bool has_buffer_storage() {
+		char const* version(reinterpret_cast<char const*>(glGetString(GL_VERSION)));
+		int major(0), minor(0);
+		if (version == nullptr || std::sscanf(version, "%d.%d", &major, &minor) != 2)
+			return false;
+		if (major > 4 || (major == 4 && minor >= 4))
+			return true;
+		if (major < 3 || (major == 3 && minor < 2))
+			return false;
+		GLint nextensions(0);
+		glGetIntegerv(GL_NUM_EXTENSIONS, &nextensions);
+		for (GLint i(0); i < nextensions; ++i) {
+			char const* extension(reinterpret_cast<char const*>(glGetStringi(GL_EXTENSIONS, i)));
+			if (extension != nullptr && std::strcmp(extension, "GL_ARB_buffer_storage") == 0)
+				return true;
+		}
+		return false;
+	}
+
+	void release_mapping() {
+		for (GLsync& fence : fences) {
+			if (fence != nullptr)
+				glDeleteSync(fence);
+			fence = nullptr;
+		}
+		if (mapped != nullptr) {
+			glBindBuffer(GL_ARRAY_BUFFER, vbo);
+			glUnmapBuffer(GL_ARRAY_BUFFER);
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+		}
+		mapped = nullptr;
+	}
+
+	// writes positions - origin (in double, see ViewProgram) to `out`
+	static void relative(std::span<vec2 const> positions, vec2 const& origin, vec2* out) {
+		for (size_t i(0); i < positions.size(); ++i)
+			out[i] = positions[i] - origin;
+	}
+
+	// copies the positions relative to `origin` into the next region of the mapped buffer, returns its offset in bytes
+	size_t upload_persistent(std::span<vec2 const> positions, vec2 const& origin) {
+		size_t n(positions.size());
+		if (n > capacity) {
+			// immutable storage cannot grow, a new buffer replaces it
+			release_mapping();
+			glDeleteBuffers(1, &vbo);
+			glGenBuffers(1, &vbo);
+			capacity = std::max(n, 2*capacity);
+			GLbitfield flags(GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT);
+			glBindBuffer(GL_ARRAY_BUFFER, vbo);
+			glBufferStorage(GL_ARRAY_BUFFER, NREGIONS*capacity*sizeof(vec2), nullptr, flags);
+			mapped = glMapBufferRange(GL_ARRAY_BUFFER, 0, NREGIONS*capacity*sizeof(vec2), flags);
+			if (mapped == nullptr) {
+				// the next frames fall back to orphaning
+				persistent = false;
+				capacity = 0;
+				glDeleteBuffers(1, &vbo);
+				glGenBuffers(1, &vbo);
+				return upload_orphan(positions, origin);
+			}
+			region = 0;
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, vbo);
+		// waits for the GPU to be done with the frame drawn NREGIONS frames ago
+		if (GLsync& fence = fences[region]; fence != nullptr) {
+			while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED) {}
+			glDeleteSync(fence);
+			fence = nullptr;
+		}
+		size_t offset(region*capacity*sizeof(vec2));
+		relative(positions, origin, reinterpret_cast<vec2*>(static_cast<char*>(mapped) + offset));
+		return offset;
+	}
+
+	// replaces the storage of the buffer, so that the driver does not wait for the previous frame to be drawn
+	size_t upload_orphan(std::span<vec2 const> positions, vec2 const& origin) {
+		size_t n(positions.size());
+		if (n > capacity)
+			capacity = std::max(n, 2*capacity);
+		staging.resize(n);
+		relative(positions, origin, staging.data());
+		glBindBuffer(GL_ARRAY_BUFFER, vbo);
+		glBufferData(GL_ARRAY_BUFFER, capacity*sizeof(vec2), nullptr, GL_STREAM_DRAW);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, n*sizeof(vec2), staging.data());
+		return 0;
+	}
+};
+
+#endif
@@ -0,0 +1,89 @@
+#ifndef __COUNT_TEXTURE_HPP__
+#define __COUNT_TEXTURE_HPP__
+
+#include <SFML/OpenGL.hpp>  // the GL 2.0+ entry points need GL_GLEXT_PROTOTYPES, defined by the build
+#include <cstdint>  // uint8_t
+#include "view_program.hpp"
+
+// Draws per-pixel counts (see PointBins) over the whole viewport
+// The counts are uploaded into a single channel texture the size of the viewport, and every pixel whose count
+// is not 0 is filled with a uniform colour, so that the image matches the one of 1 pixel GL points.
+//
+// The texture must be created, used and destroyed while a GL context sharing its objects is active.
+
+class CountTexture {
+public:
+	CountTexture() {
+		program = ViewProgram::link(VERTEX_SHADER, FRAGMENT_SHADER, "corner", "count");
+		counts_location = glGetUniformLocation(program, "counts");
+		color_location = glGetUniformLocation(program, "color");
+		glGenTextures(1, &texture);
+		// the viewport, as a triangle strip in clip space
+		GLfloat const corners[8] = {-1, -1, 1, -1, -1, 1, 1, 1};
+		glGenBuffers(1, &quad);
+		glBindBuffer(GL_ARRAY_BUFFER, quad);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	~CountTexture() {
+		glDeleteBuffers(1, &quad);
+		glDeleteTextures(1, &texture);
+		glDeleteProgram(program);
+	}
+
+	CountTexture(CountTexture const&) = delete;
+	CountTexture& operator=(CountTexture const&) = delete;
+
+	// draws the width*height `counts` (row 0 at the bottom) over the viewport
+	void draw(uint8_t const* counts, unsigned int width, unsigned int height, GLfloat const color[4]) {
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, texture);
+		GLint alignment(4);
+		glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		if (width != width_ || height != height_) {
+			width_ = width;
+			height_ = height;
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE8, width, height, 0, GL_LUMINANCE, GL_UNSIGNED_BYTE, counts);
+		} else {
+			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_LUMINANCE, GL_UNSIGNED_BYTE, counts);
+		}
+		glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+
+		glUseProgram(program);
+		glUniform1i(counts_location, 0);
+		glUniform4fv(color_location, 1, color);
+		glBindBuffer(GL_ARRAY_BUFFER, quad);
+		glEnableVertexAttribArray(ViewProgram::ATTRIBUTE);
+		glVertexAttribPointer(ViewProgram::ATTRIBUTE, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+		glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+		ViewProgram::release();
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+
+private:
+	static constexpr char const* VERTEX_SHADER =
+		"#version 120\n"
+		"attribute vec2 corner;\n"
+		"varying vec2 uv;\n"
+		"void main() { uv = corner*0.5 + 0.5; gl_Position = vec4(corner, 0.0, 1.0); }\n";
+
+	static constexpr char const* FRAGMENT_SHADER =
+		"#version 120\n"
+		"uniform sampler2D counts;\n"
+		"uniform vec4 color;\n"
+		"varying vec2 uv;\n"
+		"void main() { if (texture2D(counts, uv).r == 0.0) discard; gl_FragColor = color; }\n";
+
+	GLuint program = 0, texture = 0, quad = 0;
+	GLint counts_location = -1, color_location = -1;
+	unsigned int width_ = 0, height_ = 0;  // of the texture storage
+};
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef __CURVE_RENDERER_HPP__
+#define __CURVE_RENDERER_HPP__
+
+#include <SFML/OpenGL.hpp>  // the GL 2.0+ entry points need GL_GLEXT_PROTOTYPES, defined by the build
+#include <vector>
+#include "view_program.hpp"
+#include "curve_tessellation.hpp"
+#include "physics/world.hpp"
+#include "physics/vec2.hpp"
+
+// Retained-mode renderer for the curves
+// The curves are tessellated (see CurveTessellation) into line strips held by a static vertex buffer,
+// uploaded only when the tessellation changes, and drawn with a single glMultiDrawArrays per frame.
+// The vertices are uploaded relative to the corner of the view (see ViewProgram), and uploaded again
+// relative to the new corner once the view has been panned far away from it.
+//
+// The renderer must be created, used and destroyed while a GL context sharing its objects is active.
+
+class CurveRenderer {
+public:
+	CurveRenderer() { glGenBuffers(1, &vbo); }
+	~CurveRenderer() { glDeleteBuffers(1, &vbo); }
+
+	CurveRenderer(CurveRenderer const&) = delete;
+	CurveRenderer& operator=(CurveRenderer const&) = delete;
+
+	void set_color(float r, float g, float b, float a = 1) { color[0] = r; color[1] = g; color[2] = b; color[3] = a; }
+	// the next draw() tessellates the curves again
+	void invalidate() { tessellation.invalidate(); }
+	// vertices of the current tessellation
+	size_t nvertices() const { return tessellation.vertices().size(); }
+
+	// draws the curves of `world`, the view [view_min, view_max] (world coordinates) spanning `viewport_width` pixels
+	void draw(World const& world, vec2 const& view_min, vec2 const& view_max, unsigned int viewport_width) {
+		double width(view_max.x - view_min.x);
+		bool changed(tessellation.update(world, width / viewport_width));
+		// float keeps about 2^24 pixels of precision around the origin, which is moved well before that
+		if (changed || (view_min - origin).length() > REBASE_VIEWS * width) {
+			origin = view_min;
+			std::vector<vec2> const& vertices(tessellation.vertices());
+			staging.resize(vertices.size());
+			for (size_t i(0); i < vertices.size(); ++i)
+				staging[i] = vertices[i] - origin;
+			glBindBuffer(GL_ARRAY_BUFFER, vbo);
+			glBufferData(GL_ARRAY_BUFFER, staging.size()*sizeof(vec2), staging.data(), GL_STATIC_DRAW);
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+		}
+		if (tessellation.counts().empty())
+			return;
+
+		program.use(view_min, view_max, origin, color);
+		glLineWidth(1);
+		glBindBuffer(GL_ARRAY_BUFFER, vbo);
+		ViewProgram::attribute(0);
+		glMultiDrawArrays(GL_LINE_STRIP, tessellation.firsts().data(), tessellation.counts().data(), tessellation.counts().size());
+		ViewProgram::release();
+	}
+
+	// draws the curves of `world` with the world coordinates [0, width]x[0, height] spanning the viewport
+	void draw(World const& world, unsigned int width, unsigned int height) {
+		draw(world, vec2(0, 0), vec2(width, height), width);
+	}
+
+private:
+	static constexpr double REBASE_VIEWS = 64;  // view widths the view may be panned away from the origin
+
+	ViewProgram program;
+	GLuint vbo = 0;
+	GLfloat color[4] = {0.5, 0.5, 0.5, 1};
+	CurveTessellation tessellation;
+	vec2 origin;  // of the uploaded vertices
+	std::vector<vec2> staging;  // relative vertices of the last upload
+};
+
+#endif
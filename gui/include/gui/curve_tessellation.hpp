@@ -0,0 +1,103 @@
+#ifndef __CURVE_TESSELLATION_HPP__
+#define __CURVE_TESSELLATION_HPP__
+
+#include <cmath>  // std::abs, std::sqrt
+#include <vector>
+#include "physics/world.hpp"
+#include "physics/curve.hpp"
+#include "physics/vec2.hpp"
+
+// Line strips approximating the curves of a World, shared by the GL and software renderers
+// Segments (and Lines) take 2 vertices, the other curves are subdivided until every piece deviates
+// from its chord by less than TOLERANCE pixels at the current zoom.
+//
+// The strips are rebuilt only when the list of curves changes, when the view is zoomed in enough for the
+// pieces to become visible, or zoomed out enough for them to be wastefully small.
+// Curves modified in place are not detected, call invalidate() after editing them.
+
+class CurveTessellation {
+public:
+	static constexpr double TOLERANCE = 0.25;  // maximum distance from the curve to its tessellation, in pixels
+	static constexpr unsigned int MIN_DEPTH = 2;  // closed curves are split at least in 2^MIN_DEPTH pieces
+	static constexpr unsigned int MAX_DEPTH = 16;
+	static constexpr double LINE_EXTENT = 1e6;  // half-length of the segment drawn for an (infinite) Line
+
+	// tessellates the curves of `world` again if needed, `pixel_size` being the size of a pixel in world units
+	// returns true if the strips changed
+	bool update(World const& world, double pixel_size) {
+		double required(TOLERANCE * pixel_size);
+		if (!stale && curves == world.curve_ptrs && required >= tolerance && required <= 8*tolerance)
+			return false;
+		curves = world.curve_ptrs;
+		tolerance = required/2;
+		stale = false;
+		vertices_.clear();
+		firsts_.clear();
+		counts_.clear();
+		for (auto const& curve_ptr : curves) {
+			firsts_.push_back(vertices_.size());
+			tessellate(*curve_ptr, tolerance, vertices_);
+			counts_.push_back(vertices_.size() - firsts_.back());
+		}
+		return true;
+	}
+
+	// the next update() tessellates the curves again
+	void invalidate() { stale = true; }
+
+	// strip i is vertices()[firsts()[i], firsts()[i] + counts()[i])
+	std::vector<vec2> const& vertices() const { return vertices_; }
+	std::vector<int> const& firsts() const { return firsts_; }
+	std::vector<int> const& counts() const { return counts_; }
+
+	// appends the vertices of a line strip within `tolerance` (world units) of `curve`
+	static void tessellate(Curve const& curve, double tolerance, std::vector<vec2>& out) {
+		if (Segment const* seg = dynamic_cast<Segment const*>(&curve)) {
+			out.push_back(seg->p1);
+			out.push_back(seg->p2);
+			return;
+		}
+		if (Line const* line = dynamic_cast<Line const*>(&curve)) {
+			// long enough for the clipping to hide its ends
+			double norm(std::sqrt(line->p*line->p + line->q*line->q));
+			vec2 foot(vec2(line->p, line->q) * (-line->r / (norm*norm)));
+			vec2 dir(vec2(-line->q, line->p) / norm);
+			out.push_back(foot - dir*LINE_EXTENT);
+			out.push_back(foot + dir*LINE_EXTENT);
+			return;
+		}
+		vec2 p0(curve(0)), p1(curve(1));
+		out.push_back(p0);
+		subdivide(curve, 0, p0, 1, p1, tolerance, 0, out);
+	}
+
+private:
+	decltype(World::curve_ptrs) curves;  // tessellated curves, kept alive so that their addresses identify them
+	double tolerance = 0;  // of the tessellation, in world units
+	bool stale = true;
+	std::vector<vec2> vertices_;
+	std::vector<int> firsts_, counts_;
+
+	// appends the vertices of the curve over (t0, t1], p0 and p1 being the points at t0 and t1
+	static void subdivide(Curve const& curve, double t0, vec2 const& p0, double t1, vec2 const& p1,
+		double tolerance, unsigned int depth, std::vector<vec2>& out) {
+		double tm((t0 + t1) / 2);
+		vec2 pm(curve(tm));
+		if (depth >= MAX_DEPTH || (depth >= MIN_DEPTH && deviation(p0, pm, p1) <= tolerance)) {
+			out.push_back(p1);
+			return;
+		}
+		subdivide(curve, t0, p0, tm, pm, tolerance, depth + 1, out);
+		subdivide(curve, tm, pm, t1, p1, tolerance, depth + 1, out);
+	}
+
+	// distance from pm to the chord [p0, p1]
+	static double deviation(vec2 const& p0, vec2 const& pm, vec2 const& p1) {
+		double chord(vec2::dist(p0, p1));
+		if (chord <= 0)
+			return vec2::dist(p0, pm);
+		return std::abs(vec2::cross(p1 - p0, pm - p0)) / chord;
+	}
+};
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef __DENSITY_IMAGE_HPP__
+#define __DENSITY_IMAGE_HPP__
+
+#include <algorithm>  // std::max_element
+#include <cmath>  // std::log1p, std::lround
+#include <cstdint>  // uint8_t
+#include <vector>
+#include "physics/parallel.hpp"
+
+// Tone mapping of long-exposure density histograms (see Density::Accumulator)
+// A cell holding h is drawn with log(1 + h) / log(1 + max) of the colour, so that the sparse regions of the
+// density stay visible next to the dense ones.
+
+namespace DensityImage {
+	// writes the (ny, nx) histogram (row 0 at the bottom) into nx*ny RGBA pixels (rows from top to bottom)
+	inline void tone_map(std::vector<double> const& histogram, size_t nx, size_t ny, uint8_t* rgba,
+		float const color[3], unsigned int nthreads = Parallel::hardware_threads()) {
+		double max(histogram.empty() ? 0 : *std::max_element(histogram.begin(), histogram.end()));
+		double scale(max > 0 ? 1/std::log1p(max) : 0);
+		Parallel::for_chunks(ny, std::min<size_t>(nthreads, ny), [&](unsigned int, size_t begin, size_t end) {
+			for (size_t row(begin); row < end; ++row) {
+				double const* cells(histogram.data() + (ny - 1 - row)*nx);
+				uint8_t* out(rgba + row*nx*4);
+				for (size_t col(0); col < nx; ++col) {
+					double v(std::log1p(cells[col]) * scale);
+					out[4*col] = uint8_t(std::lround(v * color[0] * 255));
+					out[4*col + 1] = uint8_t(std::lround(v * color[1] * 255));
+					out[4*col + 2] = uint8_t(std::lround(v * color[2] * 255));
+					out[4*col + 3] = 255;
+				}
+			}
+		});
+	}
+}
+
+#endif
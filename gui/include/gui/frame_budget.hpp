@@ -0,0 +1,64 @@
+#ifndef __FRAME_BUDGET_HPP__
+#define __FRAME_BUDGET_HPP__
+
+#include <algorithm>  // std::clamp
+#include <cmath>  // std::floor
+
+// Fixed-timestep scheduling of the simulation in the render loop
+// The World is always stepped by the same dt, and the number of steps of every rendered frame is chosen
+// so that stepping takes about `budget` seconds per frame, or, when a `rate` is requested, so that
+// the simulated time advances by `rate` simulated seconds per second, as long as this fits in the budget.
+// The cost of a step is measured every frame and smoothed, so the number of steps follows the number of balls,
+// of collisions and of threads.
+
+class FrameBudget {
+public:
+	struct Settings {
+		double dt;  // simulated time of a step
+		double budget = 0.010;  // seconds of stepping per frame
+		double rate = 0;  // simulated seconds per second, 0: as many steps as fit in the budget
+		unsigned int max_steps = 1 << 16;  // per frame
+	};
+
+	static constexpr double SMOOTHING = 0.2;  // weight of the last measure in the step cost
+
+	explicit FrameBudget(Settings const& settings) : settings_(settings) {}
+
+	Settings const& settings() const { return settings_; }
+
+	// number of steps to take in a frame starting `elapsed` seconds after the previous one
+	unsigned int plan(double elapsed) {
+		// the first frame takes a single step, to measure it
+		double affordable(cost > 0 ? std::floor(settings_.budget / cost) : 1);
+		unsigned int steps(std::clamp(affordable, 1.0, double(settings_.max_steps)));
+		if (settings_.rate <= 0)
+			return steps;
+		backlog += elapsed * settings_.rate;
+		double due(std::floor(backlog / settings_.dt));
+		if (due > steps) {
+			// the simulation cannot keep up, the time it is late is dropped instead of piling up
+			backlog = 0;
+			return steps;
+		}
+		backlog -= due * settings_.dt;
+		return due;
+	}
+
+	// measured duration (in seconds) of the `steps` steps of the last frame
+	void record(unsigned int steps, double seconds) {
+		if (steps == 0)
+			return;
+		double measured(seconds / steps);
+		cost = cost > 0 ? cost + SMOOTHING * (measured - cost) : measured;
+	}
+
+	// smoothed duration of a step, in seconds (0 before the first measure)
+	double step_cost() const { return cost; }
+
+private:
+	Settings settings_;
+	double cost = 0;
+	double backlog = 0;  // simulated time not stepped yet
+};
+
+#endif
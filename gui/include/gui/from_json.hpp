@@ -1,67 +1,503 @@
 #ifndef __FROM_JSON_HPP__
 #define __FROM_JSON_HPP__
 
-#include <cassert>  // assert
-#include <memory> // std::make_shared
-#include <iostream>
+#include <algorithm>  // std::min
+#include <charconv>  // std::from_chars
+#include <chrono>
+#include <cstdint>  // uint64_t
+#include <cmath>  // std::isfinite, std::floor
+#include <filesystem>  // std::filesystem::file_size
+#include <fstream>
+#include <memory>  // std::make_shared, std::make_unique
+#include <stdexcept>  // std::runtime_error
+#include <string>
+#include <string_view>
+#include <vector>
 
 #include "physics/world.hpp"
 #include "physics/ball.hpp"
+#include "physics/ball_generator.hpp"
 #include "physics/curve.hpp"
 #include "physics/vec2.hpp"
+#include "physics/worldfile.hpp"
 
-#include "json/json.hpp"
-
-// Utility functions to parse json
+// Streaming world file loader
+// The file is parsed in a single pass, without building a DOM: balls are written straight
+// into the contiguous storage of the World, and numbers are parsed with std::from_chars.
 // These methods are not in the physics classes,
 // because I don't want to bloat the includes in the physics module
 
-vec2 vec2_from_json(nlohmann::json const& j) {
-	assert(j["class"] == "vec2");
-	return vec2(j["parameters"]["x"], j["parameters"]["y"]);
-}
+struct LoadStats {
+	size_t bytes = 0;
+	size_t balls = 0;
+	size_t curves = 0;
+	double seconds = 0;  // reading and parsing
+
+	// parse throughput in bytes per second
+	double throughput() const { return seconds > 0 ? bytes / seconds : 0; }
+
+	std::string str() const {
+		return "loaded " + std::to_string(balls) + " balls and " + std::to_string(curves) + " curves"
+			+ " (" + std::to_string(bytes / 1e6) + " MB) in " + std::to_string(seconds * 1e3) + " ms"
+			+ " (" + std::to_string(throughput() / 1e6) + " MB/s)";
+	}
+};
+
+// Pull parser over an in-memory JSON document, reporting errors with their line and column
+class JsonReader {
+	char const* begin;
+	char const* p;
+	char const* end;
+	std::string scratch;  // unescaped strings
+
+public:
+	explicit JsonReader(std::string_view text)
+		: begin(text.data()), p(text.data()), end(text.data() + text.size()) {}
+
+	[[noreturn]] void fail(std::string const& msg) const {
+		size_t line(1), column(1);
+		for (char const* c(begin); c < p; ++c) {
+			if (*c == '\n') { ++line; column = 1; }
+			else ++column;
+		}
+		throw std::runtime_error("invalid world file at line " + std::to_string(line) + ", column " + std::to_string(column) + " : " + msg);
+	}
+
+	void skip_whitespace() {
+		while (p < end && (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t'))
+			++p;
+	}
+
+	bool at_end() {
+		skip_whitespace();
+		return p == end;
+	}
+
+	char peek() {
+		skip_whitespace();
+		return p < end ? *p : '\0';
+	}
+
+	bool consume(char c) {
+		if (peek() != c)
+			return false;
+		++p;
+		return true;
+	}
+
+	void expect(char c) {
+		if (!consume(c))
+			fail(std::string("expected `") + c + "`");
+	}
+
+	// the returned view is only valid until the next string is read
+	std::string_view string() {
+		expect('"');
+		char const* start(p);
+		while (p < end && *p != '"' && *p != '\\')
+			++p;
+		if (p < end && *p == '"')
+			return std::string_view(start, p++ - start);
+
+		// slow path for escaped strings
+		scratch.assign(start, p);
+		while (p < end && *p != '"') {
+			if (*p != '\\') {
+				scratch += *p++;
+				continue;
+			}
+			if (++p == end)
+				break;
+			switch (*p++) {
+				case '"': scratch += '"'; break;
+				case '\\': scratch += '\\'; break;
+				case '/': scratch += '/'; break;
+				case 'b': scratch += '\b'; break;
+				case 'f': scratch += '\f'; break;
+				case 'n': scratch += '\n'; break;
+				case 'r': scratch += '\r'; break;
+				case 't': scratch += '\t'; break;
+				case 'u': {
+					unsigned int code(0);
+					if (end - p < 4 || std::from_chars(p, p + 4, code, 16).ptr != p + 4)
+						fail("invalid unicode escape");
+					p += 4;
+					// encode the (BMP) code point as UTF-8
+					if (code < 0x80) {
+						scratch += char(code);
+					} else if (code < 0x800) {
+						scratch += char(0xC0 | (code >> 6));
+						scratch += char(0x80 | (code & 0x3F));
+					} else {
+						scratch += char(0xE0 | (code >> 12));
+						scratch += char(0x80 | ((code >> 6) & 0x3F));
+						scratch += char(0x80 | (code & 0x3F));
+					}
+					break;
+				}
+				default: --p; fail("invalid escape sequence");
+			}
+		}
+		if (p == end)
+			fail("unterminated string");
+		++p;
+		return scratch;
+	}
+
+	double number() {
+		skip_whitespace();
+		// from_chars also accepts "inf" and "nan", which are not JSON
+		if (p == end || !(*p == '-' || ('0' <= *p && *p <= '9')))
+			fail("expected a number");
+		double value;
+		std::from_chars_result res(std::from_chars(p, end, value));
+		if (res.ec == std::errc::result_out_of_range)
+			fail("number out of range");
+		if (res.ec != std::errc())
+			fail("expected a number");
+		p = res.ptr;
+		return value;
+	}
+
+	// reads a number written as a plain non-negative integer (no fraction or exponent) that fits in 64 bits,
+	// exactly, otherwise returns false without consuming anything
+	bool unsigned_integer(uint64_t& value) {
+		skip_whitespace();
+		std::from_chars_result res(std::from_chars(p, end, value));
+		if (res.ec != std::errc() || (res.ptr != end && (*res.ptr == '.' || *res.ptr == 'e' || *res.ptr == 'E')))
+			return false;
+		p = res.ptr;
+		return true;
+	}
+
+	void literal(std::string_view word) {
+		skip_whitespace();
+		if (std::string_view(p, std::min<size_t>(end - p, word.size())) != word)
+			fail("invalid literal");
+		p += word.size();
+	}
+
+	// calls on_key(key) for each key of an object, on_key must consume the value
+	// the key is only valid until the value starts being read
+	template <typename OnKey>
+	void object(OnKey&& on_key) {
+		expect('{');
+		if (consume('}'))
+			return;
+		do {
+			if (peek() != '"')
+				fail("expected a key");
+			std::string_view key(string());
+			expect(':');
+			on_key(key);
+		} while (consume(','));
+		expect('}');
+	}
+
+	// calls on_element() for each element of an array, on_element must consume the element
+	template <typename OnElement>
+	void array(OnElement&& on_element) {
+		expect('[');
+		if (consume(']'))
+			return;
+		do {
+			on_element();
+		} while (consume(','));
+		expect(']');
+	}
+
+	void skip_value() {
+		switch (peek()) {
+			case '{': object([&](std::string_view) { skip_value(); }); break;
+			case '[': array([&]() { skip_value(); }); break;
+			case '"': string(); break;
+			case 't': literal("true"); break;
+			case 'f': literal("false"); break;
+			case 'n': literal("null"); break;
+			default: number();
+		}
+	}
+};
 
-Ball Ball_from_json(nlohmann::json const& j) {
-	assert(j["class"] == "Ball");
-	return Ball(vec2_from_json(j["parameters"]["pos"]), vec2_from_json(j["parameters"]["vel"]));
+// Parses `{"class": <class_name>, "parameters": {...}}`, in any key order,
+// calling on_parameter(name) for each parameter (which must consume the value)
+template <typename OnParameter>
+void json_object_of_class(JsonReader& in, std::string_view class_name, OnParameter&& on_parameter) {
+	bool has_class(false), has_parameters(false);
+	in.object([&](std::string_view key) {
+		if (key == "class") {
+			if (in.string() != class_name)
+				in.fail("expected class `" + std::string(class_name) + "`");
+			has_class = true;
+		} else if (key == "parameters") {
+			in.object(on_parameter);
+			has_parameters = true;
+		} else {
+			in.fail("unexpected key `" + std::string(key) + "`");
+		}
+	});
+	if (!has_class || !has_parameters)
+		in.fail("`" + std::string(class_name) + "` needs a class and parameters");
 }
 
-Segment Segment_from_json(nlohmann::json const& j) {
-	assert(j["class"] == "Segment");
-	return Segment(vec2_from_json(j["parameters"]["p1"]), vec2_from_json(j["parameters"]["p2"]));
+inline double finite_from_json(JsonReader& in) {
+	double x(in.number());
+	if (!std::isfinite(x))
+		in.fail("number must be finite");
+	return x;
 }
 
-Arc Arc_from_json(nlohmann::json const& j) {
-	assert(j["class"] == "Arc");
-	return Arc(vec2_from_json(j["parameters"]["p0"]), j["parameters"]["r"], j["parameters"]["theta_min"], j["parameters"]["theta_max"]);
+inline vec2 vec2_from_json(JsonReader& in) {
+	vec2 v;
+	unsigned int seen(0);
+	json_object_of_class(in, "vec2", [&](std::string_view key) {
+		if (key == "x") { v.x = finite_from_json(in); seen |= 1; }
+		else if (key == "y") { v.y = finite_from_json(in); seen |= 2; }
+		else in.fail("unexpected vec2 parameter `" + std::string(key) + "`");
+	});
+	if (seen != 3)
+		in.fail("vec2 needs parameters x and y");
+	return v;
 }
 
-BezierCubic BezierCubic_from_json(nlohmann::json const& j) {
-	assert(j["class"] == "BezierCubic");
-	return BezierCubic(vec2_from_json(j["parameters"]["p0"]), vec2_from_json(j["parameters"]["p1"]), vec2_from_json(j["parameters"]["p2"]), vec2_from_json(j["parameters"]["p3"]));
+inline void Ball_from_json(JsonReader& in, Balls& balls) {
+	vec2 pos, vel;
+	unsigned int seen(0);
+	json_object_of_class(in, "Ball", [&](std::string_view key) {
+		if (key == "pos") { pos = vec2_from_json(in); seen |= 1; }
+		else if (key == "vel") { vel = vec2_from_json(in); seen |= 2; }
+		else in.fail("unexpected Ball parameter `" + std::string(key) + "`");
+	});
+	if (seen != 3)
+		in.fail("Ball needs parameters pos and vel");
+	balls.push_back(pos, vel);
 }
 
-World World_from_json(nlohmann::json const& j) {
-	World world;
+// Curve parameters are buffered, because the class may come after the parameters
+struct CurveParameters {
+	struct Parameter {
+		std::string name;
+		bool is_vec2;
+		vec2 v;
+		double x;
+		bool is_integer = false;
+		uint64_t integer = 0;  // exact value of integer tokens, which may not be representable as a double
+	};
+	std::vector<Parameter> parameters;
+	size_t used = 0;
 
-	for (auto& el : j["balls"].items())
-		world.add_ball(std::make_shared<Ball>(Ball_from_json(el.value())));
+	Parameter const* find(std::string_view name) const {
+		for (Parameter const& param : parameters)
+			if (param.name == name)
+				return &param;
+		return nullptr;
+	}
 
-	for (auto& el : j["curves"].items()) {
-		if (el.value()["class"] == "Segment") {
-			world.add_curve(std::make_shared<Segment>(Segment_from_json(el.value())));
-		}
-		else if (el.value()["class"] == "Arc") {
-			world.add_curve(std::make_shared<Arc>(Arc_from_json(el.value())));
-		}
-		else if (el.value()["class"] == "BezierCubic") {
-			world.add_curve(std::make_shared<BezierCubic>(BezierCubic_from_json(el.value())));
+	vec2 vec(JsonReader& in, std::string_view name) {
+		Parameter const* param(find(name));
+		if (param == nullptr || !param->is_vec2)
+			in.fail("missing vec2 parameter `" + std::string(name) + "`");
+		++used;
+		return param->v;
+	}
+
+	double num(JsonReader& in, std::string_view name) {
+		Parameter const* param(find(name));
+		if (param == nullptr || param->is_vec2)
+			in.fail("missing number parameter `" + std::string(name) + "`");
+		++used;
+		return param->x;
+	}
+
+	// non-negative integer, exact when written as an integer, otherwise exactly representable as a double
+	uint64_t count(JsonReader& in, std::string_view name) {
+		double x(num(in, name));
+		if (find(name)->is_integer)
+			return find(name)->integer;
+		if (x < 0 || x != std::floor(x) || x > 0x1p53)
+			in.fail("parameter `" + std::string(name) + "` must be a non-negative integer");
+		return uint64_t(x);
+	}
+};
+
+// reads `{"class": ..., "parameters": {...}}` into `params`, returns the class name
+inline std::string parameters_from_json(JsonReader& in, CurveParameters& params) {
+	std::string class_name;
+	bool has_parameters(false);
+
+	in.object([&](std::string_view key) {
+		if (key == "class") {
+			class_name = in.string();
+		} else if (key == "parameters") {
+			has_parameters = true;
+			in.object([&](std::string_view key) {
+				std::string name(key);
+				if (params.find(name) != nullptr)
+					in.fail("duplicate parameter `" + name + "`");
+				if (in.peek() == '{') {
+					vec2 v(vec2_from_json(in));
+					params.parameters.push_back({name, true, v, 0});
+				} else if (uint64_t integer; in.unsigned_integer(integer)) {
+					params.parameters.push_back({name, false, vec2(), double(integer), true, integer});
+				} else {
+					double x(finite_from_json(in));
+					params.parameters.push_back({name, false, vec2(), x});
+				}
+			});
+		} else {
+			in.fail("unexpected key `" + std::string(key) + "`");
 		}
-		else {
-			std::cout << "class `" << el.value()["class"] << "` not recognized" << std::endl;
+	});
+	if (!has_parameters)
+		in.fail("`" + class_name + "` needs parameters");
+	return class_name;
+}
+
+inline std::shared_ptr<Curve> Curve_from_json(JsonReader& in) {
+	CurveParameters params;
+	std::string class_name(parameters_from_json(in, params));
+
+	std::shared_ptr<Curve> curve_ptr;
+	if (class_name == "Segment") {
+		curve_ptr = std::make_shared<Segment>(params.vec(in, "p1"), params.vec(in, "p2"));
+	} else if (class_name == "Arc") {
+		vec2 p0(params.vec(in, "p0"));
+		double r(params.num(in, "r"));
+		if (r <= 0)
+			in.fail("Arc radius must be positive");
+		curve_ptr = std::make_shared<Arc>(p0, r, params.num(in, "theta_min"), params.num(in, "theta_max"));
+	} else if (class_name == "BezierCubic") {
+		vec2 p0(params.vec(in, "p0")), p1(params.vec(in, "p1")), p2(params.vec(in, "p2")), p3(params.vec(in, "p3"));
+		curve_ptr = std::make_shared<BezierCubic>(p0, p1, p2, p3);
+	} else if (class_name == "Line") {
+		double p(params.num(in, "p")), q(params.num(in, "q")), r(params.num(in, "r"));
+		curve_ptr = std::make_shared<Line>(p, q, r);
+	} else if (class_name == "Ellipse") {
+		vec2 p0(params.vec(in, "p0"));
+		double a(params.num(in, "a")), b(params.num(in, "b")), phi(params.num(in, "phi"));
+		if (a <= 0 || b <= 0)
+			in.fail("Ellipse radii must be positive");
+		curve_ptr = std::make_shared<Ellipse>(p0, a, b, phi, params.num(in, "theta_min"), params.num(in, "theta_max"));
+	} else {
+		in.fail("class `" + class_name + "` not recognized");
+	}
+	if (params.used != params.parameters.size())
+		in.fail("unexpected parameters for class `" + class_name + "`");
+	return curve_ptr;
+}
+
+// Upper bound on the balls of a world file (48 bytes each), so that a typo such as "n": 1e15 is reported
+// with its location instead of failing to allocate the columns
+constexpr uint64_t MAX_BALLS = uint64_t(1) << 30;
+
+// Expands the generator straight into the balls of the World (see physics/ball_generator.hpp)
+inline void BallGenerator_from_json(JsonReader& in, World& world) {
+	CurveParameters params;
+	std::string class_name(parameters_from_json(in, params));
+
+	std::unique_ptr<BallGenerator> generator;
+	if (class_name == "LineGenerator") {
+		vec2 p1(params.vec(in, "p1")), p2(params.vec(in, "p2")), vel(params.vec(in, "vel"));
+		generator = std::make_unique<LineGenerator>(p1, p2, vel, params.count(in, "n"));
+	} else if (class_name == "FanGenerator") {
+		vec2 p0(params.vec(in, "p0"));
+		double angle_min(params.num(in, "angle_min")), angle_max(params.num(in, "angle_max")), speed(params.num(in, "speed"));
+		generator = std::make_unique<FanGenerator>(p0, angle_min, angle_max, speed, params.count(in, "n"));
+	} else if (class_name == "GridGenerator") {
+		vec2 pmin(params.vec(in, "pmin")), pmax(params.vec(in, "pmax")), vel(params.vec(in, "vel"));
+		uint64_t nx(params.count(in, "nx")), ny(params.count(in, "ny"));
+		if (ny != 0 && nx > (uint64_t(1) << 53) / ny)
+			in.fail("too many balls");
+		generator = std::make_unique<GridGenerator>(pmin, pmax, vel, nx, ny);
+	} else if (class_name == "UniformGenerator") {
+		vec2 pmin(params.vec(in, "pmin")), pmax(params.vec(in, "pmax"));
+		double speed(params.num(in, "speed"));
+		uint64_t n(params.count(in, "n"));
+		// the seed is optional
+		uint64_t seed(params.find("seed") != nullptr ? params.count(in, "seed") : 0);
+		generator = std::make_unique<UniformGenerator>(pmin, pmax, speed, n, seed);
+	} else {
+		in.fail("class `" + class_name + "` not recognized");
+	}
+	if (params.used != params.parameters.size())
+		in.fail("unexpected parameters for class `" + class_name + "`");
+	if (generator->size() > MAX_BALLS - std::min<uint64_t>(MAX_BALLS, world.balls.size()))
+		in.fail("too many balls, a world file holds at most " + std::to_string(MAX_BALLS));
+	world.add_balls(*generator);
+}
+
+inline World World_from_json(std::string_view text, LoadStats* stats = nullptr) {
+	auto tstart(std::chrono::steady_clock::now());
+	World world;
+	JsonReader in(text);
+	bool has_balls(false), has_curves(false), has_generators(false);
+
+	in.object([&](std::string_view key) {
+		if (key == "balls") {
+			has_balls = true;
+			in.array([&]() { Ball_from_json(in, world.balls); });
+		} else if (key == "curves") {
+			has_curves = true;
+			in.array([&]() { world.add_curve(Curve_from_json(in)); });
+		} else if (key == "generators") {
+			// balls are added in the order of the file, explicit or generated
+			has_generators = true;
+			in.array([&]() { BallGenerator_from_json(in, world); });
+		} else {
+			// unknown sections are ignored, to stay compatible with newer world files
+			in.skip_value();
 		}
+	});
+	if (!in.at_end())
+		in.fail("unexpected data after the world");
+	if (!(has_balls || has_generators) || !has_curves)
+		in.fail("world needs balls (or generators) and curves");
+
+	if (stats != nullptr) {
+		stats->bytes += text.size();
+		stats->balls += world.balls.size();
+		stats->curves += world.curve_ptrs.size();
+		stats->seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - tstart).count();
 	}
+	return world;
+}
+
+inline World World_from_json_file(std::string const& filepath, LoadStats* stats = nullptr) {
+	auto tstart(std::chrono::steady_clock::now());
+	std::ifstream file(filepath, std::ios::binary | std::ios::ate);
+	if (!file)
+		throw std::runtime_error("failed to open file `" + filepath + "`");
+	std::string text(size_t(file.tellg()), '\0');
+	file.seekg(0);
+	if (!file.read(text.data(), text.size()))
+		throw std::runtime_error("failed to read file `" + filepath + "`");
 
+	LoadStats parse_stats;
+	World world(World_from_json(text, &parse_stats));
+	if (stats != nullptr) {
+		parse_stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - tstart).count();
+		stats->bytes += parse_stats.bytes;
+		stats->balls += parse_stats.balls;
+		stats->curves += parse_stats.curves;
+		stats->seconds += parse_stats.seconds;
+	}
+	return world;
+}
+
+// Loads a binary world file (memory-mapped, see physics/worldfile.hpp) or a JSON world file
+// The balls of a binary world file are not parsed, only mapped, so the throughput is not comparable
+inline World World_from_file(std::string const& filepath, LoadStats* stats = nullptr) {
+	if (!WorldFile::is_world_file(filepath))
+		return World_from_json_file(filepath, stats);
+
+	auto tstart(std::chrono::steady_clock::now());
+	World world(WorldFile::load(filepath));
+	if (stats != nullptr) {
+		stats->bytes += std::filesystem::file_size(filepath);
+		stats->balls += world.balls.size();
+		stats->curves += world.curve_ptrs.size();
+		stats->seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - tstart).count();
+	}
 	return world;
 }
 
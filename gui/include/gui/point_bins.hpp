@@ -0,0 +1,70 @@
+#ifndef __POINT_BINS_HPP__
+#define __POINT_BINS_HPP__
+
+#include <algorithm>  // std::min, std::max, std::fill
+#include <cstdint>  // uint8_t
+#include <span>
+#include <vector>
+#include "physics/parallel.hpp"
+#include "physics/vec2.hpp"
+
+// Screen-resolution counts of points, binned on the CPU
+// When there are more balls than pixels, counting the balls of every pixel and uploading the counts
+// is cheaper than sending every position to the GPU (see BallRenderer).
+// A point is counted in the cell containing it, which is the pixel a 1 pixel GL point at that position covers.
+//
+// Each thread counts its share of the points into its own grid, the grids are then summed in parallel over the cells.
+// Counts saturate at 255.
+
+class PointBins {
+public:
+	explicit PointBins(unsigned int nthreads = Parallel::hardware_threads()) : nthreads(std::max(1u, nthreads)) {}
+
+	// counts the `positions` falling in each of the width*height cells spanning [view_min, view_max]
+	void bin(std::span<vec2 const> positions, vec2 const& view_min, vec2 const& view_max, unsigned int width, unsigned int height) {
+		width_ = width;
+		height_ = height;
+		size_t ncells(size_t(width)*height);
+		// a thread clears and merges a whole grid, so it needs at least as many points as cells to pay off
+		unsigned int nchunks(std::clamp<size_t>(positions.size() / std::max<size_t>(ncells, 1), 1, nthreads));
+		if (grids.size() < nchunks)
+			grids.resize(nchunks);
+		double sx(width / (view_max.x - view_min.x)), sy(height / (view_max.y - view_min.y));
+
+		Parallel::for_chunks(positions.size(), nchunks, [&](unsigned int chunk, size_t begin, size_t end) {
+			std::vector<uint8_t>& grid(grids[chunk]);
+			// the points outside of the view go to an extra cell, which avoids a hard to predict branch
+			grid.assign(ncells + 1, 0);
+			for (size_t i(begin); i < end; ++i) {
+				double x((positions[i].x - view_min.x) * sx);
+				double y((positions[i].y - view_min.y) * sy);
+				// also rejects NaNs
+				bool inside(x >= 0 && x < width && y >= 0 && y < height);
+				uint8_t& count(grid[inside ? size_t(y)*width + size_t(x) : ncells]);
+				count += count != UINT8_MAX;
+			}
+		});
+
+		// the grids are summed into the first one
+		Parallel::for_chunks(ncells, std::min<size_t>(nchunks, ncells), [&](unsigned int, size_t begin, size_t end) {
+			uint8_t* total(grids[0].data());
+			for (unsigned int chunk(1); chunk < nchunks; ++chunk) {
+				uint8_t const* grid(grids[chunk].data());
+				for (size_t i(begin); i < end; ++i)
+					total[i] = std::min<unsigned int>(total[i] + grid[i], UINT8_MAX);
+			}
+		});
+	}
+
+	unsigned int width() const { return width_; }
+	unsigned int height() const { return height_; }
+	// width*height counts, row-major, row 0 at view_min.y (the layout of a GL texture)
+	uint8_t const* counts() const { return grids.empty() ? nullptr : grids[0].data(); }
+
+private:
+	unsigned int nthreads;
+	unsigned int width_ = 0, height_ = 0;
+	std::vector<std::vector<uint8_t>> grids;  // one per thread
+};
+
+#endif
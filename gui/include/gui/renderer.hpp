@@ -4,10 +4,12 @@
 #include <fstream>
 #include <iostream>
 #include <SFML/Graphics.hpp>
+#include <SFML/OpenGL.hpp>
 #include "settings.hpp"
 #include "exceptions.hpp"
-
-class World;
+#include "ball_renderer.hpp"
+#include "curve_renderer.hpp"
+#include "physics/world.hpp"
 
 class Renderer {
 public:
@@ -47,16 +49,31 @@ public:
 
 
 class SFMLRenderer : public Renderer, public sf::RenderWindow {
+private:
+	// created once the window (and its GL context) exists
+	BallRenderer balls;
+	CurveRenderer curves;
+
 public:
 	explicit SFMLRenderer()
 		: sf::RenderWindow(sf::VideoMode(Settings::WINDOW_WIDTH, Settings::WINDOW_HEIGHT), "chaotic billiard") {};
-	virtual ~SFMLRenderer() {}
+	virtual ~SFMLRenderer() { setActive(true); }  // the vertex buffers are released in the window context
 
 	SFMLRenderer(SFMLRenderer const&) = delete;
 	SFMLRenderer& operator = (SFMLRenderer const&) = delete;
 
+	using sf::RenderWindow::draw;
+
 	void draw(World const& world) {
-		// TODO
+		if (!setActive(true))
+			return;
+		sf::Vector2u size(getSize());
+		glViewport(0, 0, size.x, size.y);
+		glClearColor(0.0, 0.0, 0.0, 0.0);
+		glClear(GL_COLOR_BUFFER_BIT);
+		balls.draw(world.positions(), size.x, size.y);
+		curves.draw(world, size.x, size.y);
+		display();
 	}
 };
 
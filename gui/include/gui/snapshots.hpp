@@ -0,0 +1,199 @@
+#ifndef __SNAPSHOTS_HPP__
+#define __SNAPSHOTS_HPP__
+
+#include <cstdint>  // uint32_t, uint64_t
+#include <cstdio>  // std::FILE, std::fopen
+#include <cstring>  // std::memcpy, std::memcmp
+#include <span>
+#include <stdexcept>  // std::runtime_error, std::out_of_range
+#include <string>
+#include <vector>
+#include <fcntl.h>  // open
+#include <sys/mman.h>  // mmap, munmap, madvise
+#include <sys/stat.h>  // fstat
+#include <unistd.h>  // close, sysconf
+#include "physics/vec2.hpp"
+
+// Snapshot files, for rendering frames once the simulation is over (--record, then --render-from)
+// Unlike trajectory files (see Trajectory::Recorder), snapshots only hold what is drawn: the time and the positions
+// of the balls, in single precision, uncompressed, so that every frame is at a known offset and the frames are
+// rendered in any order, by any number of threads.
+//
+// Layout (native endianness):
+//   Header                  64 bytes
+//   frames                  nframes * (8 + 8*nballs) bytes: the time (double), then x, y (float) of every ball
+//
+// The reader maps the file, and the pages of the frames that have been rendered are released,
+// so that the memory used does not grow with the length of the recording.
+
+namespace Snapshots {
+	constexpr char MAGIC[8] = {'C', 'B', 'S', 'N', 'A', 'P', '\0', '\0'};
+	constexpr uint32_t VERSION = 1;
+	constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+	struct Header {
+		char magic[8];
+		uint32_t version;
+		uint32_t byte_order;
+		uint64_t nballs;
+		uint64_t nframes;  // 0 while the file is being recorded
+		uint64_t reserved[4];
+	};
+
+	inline size_t frame_bytes(size_t nballs) { return sizeof(double) + nballs*2*sizeof(float); }
+
+	inline std::runtime_error invalid(std::string const& filepath, std::string const& reason) {
+		return std::runtime_error("invalid snapshot file `" + filepath + "`: " + reason);
+	}
+
+	class Writer {
+	public:
+		Writer(std::string const& filepath, size_t nballs)
+			: filepath(filepath), file(std::fopen(filepath.c_str(), "wb")), header{}, buffer(frame_bytes(nballs)) {
+			if (file == nullptr)
+				throw std::runtime_error("failed to open file `" + filepath + "`");
+			std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+			header.version = VERSION;
+			header.byte_order = BYTE_ORDER_MARK;
+			header.nballs = nballs;
+			// placeholder until close(), readers reject files without frame count
+			if (std::fwrite(&header, sizeof(Header), 1, file) != 1) {
+				std::fclose(file);
+				throw std::runtime_error("failed to write file `" + filepath + "`");
+			}
+		}
+
+		// closes the file, errors are only reported by an explicit close()
+		~Writer() {
+			try { close(); }
+			catch (...) {}
+		}
+
+		Writer(Writer const&) = delete;
+		Writer& operator=(Writer const&) = delete;
+
+		// appends a frame, all frames must have the same number of balls
+		void write(double time, std::span<vec2 const> positions) {
+			if (file == nullptr)
+				throw std::runtime_error("snapshot file `" + filepath + "` is closed");
+			if (positions.size() != header.nballs)
+				throw std::runtime_error("snapshot of " + std::to_string(positions.size()) + " balls, the file has "
+					+ std::to_string(header.nballs));
+			std::memcpy(buffer.data(), &time, sizeof(double));
+			float* xy(reinterpret_cast<float*>(buffer.data() + sizeof(double)));
+			for (size_t i(0); i < positions.size(); ++i) {
+				xy[2*i] = positions[i].x;
+				xy[2*i + 1] = positions[i].y;
+			}
+			if (std::fwrite(buffer.data(), 1, buffer.size(), file) != buffer.size())
+				throw std::runtime_error("failed to write file `" + filepath + "`");
+			++header.nframes;
+		}
+
+		// writes the frame count, throws std::runtime_error if the file cannot be written
+		void close() {
+			if (file == nullptr)
+				return;
+			std::FILE* f(file);
+			file = nullptr;
+			bool ok(std::fseek(f, 0, SEEK_SET) == 0 && std::fwrite(&header, sizeof(Header), 1, f) == 1);
+			ok = std::fclose(f) == 0 && ok;
+			if (!ok)
+				throw std::runtime_error("failed to write file `" + filepath + "`");
+		}
+
+		uint64_t nframes() const { return header.nframes; }
+
+	private:
+		std::string filepath;
+		std::FILE* file;
+		Header header;
+		std::vector<unsigned char> buffer;  // one frame
+	};
+
+	class Reader {
+	public:
+		explicit Reader(std::string const& filepath) : filepath(filepath) {
+			int fd(::open(filepath.c_str(), O_RDONLY));
+			if (fd < 0)
+				throw std::runtime_error("failed to open file `" + filepath + "`");
+			struct stat info;
+			if (::fstat(fd, &info) != 0 || size_t(info.st_size) < sizeof(Header)) {
+				::close(fd);
+				throw invalid(filepath, "file too small");
+			}
+			size = info.st_size;
+			data = static_cast<unsigned char const*>(::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0));
+			::close(fd);  // the mapping stays valid
+			if (data == MAP_FAILED)
+				throw std::runtime_error("failed to map file `" + filepath + "`");
+			std::memcpy(&header, data, sizeof(Header));
+			try {
+				if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0)
+					throw invalid(filepath, "bad magic");
+				if (header.byte_order != BYTE_ORDER_MARK)
+					throw invalid(filepath, "written on a machine of different endianness");
+				if (header.version != VERSION)
+					throw invalid(filepath, "unsupported version " + std::to_string(header.version));
+				if (header.nframes == 0)
+					throw invalid(filepath, "recording was not closed, or is empty");
+				if (header.nballs > (SIZE_MAX - sizeof(double)) / (2*sizeof(float))
+					|| header.nframes > (size - sizeof(Header)) / frame_bytes(header.nballs))
+					throw invalid(filepath, "truncated frames");
+			} catch (...) {
+				::munmap(const_cast<unsigned char*>(data), size);
+				throw;
+			}
+			// the frames are mostly read in order
+			::madvise(const_cast<unsigned char*>(data), size, MADV_SEQUENTIAL);
+		}
+
+		~Reader() { ::munmap(const_cast<unsigned char*>(data), size); }
+
+		Reader(Reader const&) = delete;
+		Reader& operator=(Reader const&) = delete;
+
+		size_t nballs() const { return header.nballs; }
+		size_t nframes() const { return header.nframes; }
+
+		// time of frame `k`
+		double time(size_t k) const {
+			double t;
+			std::memcpy(&t, frame(k), sizeof(double));
+			return t;
+		}
+
+		// positions of frame `k`, into `pos` (nballs values)
+		// safe to call concurrently
+		void read(size_t k, vec2* pos) const {
+			float const* xy(reinterpret_cast<float const*>(frame(k) + sizeof(double)));
+			for (size_t i(0); i < header.nballs; ++i)
+				pos[i] = vec2(xy[2*i], xy[2*i + 1]);
+		}
+
+		// drops the pages only holding frame `k` from memory, they are read again from the file if needed
+		void release(size_t k) const {
+			size_t page(::sysconf(_SC_PAGESIZE));
+			size_t begin(frame(k) - data), end(begin + frame_bytes(header.nballs));
+			begin = (begin + page - 1) / page * page;
+			end = end / page * page;
+			if (begin < end)
+				::madvise(const_cast<unsigned char*>(data) + begin, end - begin, MADV_DONTNEED);
+		}
+
+	private:
+		std::string filepath;
+		unsigned char const* data = nullptr;
+		size_t size = 0;
+		Header header;
+
+		unsigned char const* frame(size_t k) const {
+			if (k >= header.nframes)
+				throw std::out_of_range("frame " + std::to_string(k) + " out of range, the recording has "
+					+ std::to_string(header.nframes) + " frames");
+			return data + sizeof(Header) + k*frame_bytes(header.nballs);
+		}
+	};
+}
+
+#endif
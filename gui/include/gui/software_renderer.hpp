@@ -0,0 +1,212 @@
+#ifndef __SOFTWARE_RENDERER_HPP__
+#define __SOFTWARE_RENDERER_HPP__
+
+#include <algorithm>  // std::min, std::max, std::fill
+#include <cmath>  // std::floor, std::ceil, std::abs, std::lround
+#include <cstdint>  // uint8_t, uint32_t
+#include <cstring>  // std::memcpy
+#include <span>
+#include <utility>  // std::pair
+#include <vector>
+#include "curve_tessellation.hpp"
+#include "physics/world.hpp"
+#include "physics/parallel.hpp"
+#include "physics/vec2.hpp"
+
+// CPU rasteriser for headless rendering
+// Draws the balls (1 pixel points) and the tessellated curves (1 pixel wide lines) of a World into an RGBA buffer,
+// like the GL renderers, but without any GL context, driver or display.
+//
+// The image is split into horizontal bands, one per thread. The balls are first binned by band in parallel
+// (each thread counts, then scatters its share of the balls), then every thread fills its own band.
+// No two threads write the same pixel, and the image does not depend on the number of threads.
+
+class SoftwareRenderer {
+public:
+	SoftwareRenderer(unsigned int width, unsigned int height, unsigned int nthreads = Parallel::hardware_threads())
+		: width_(width), height_(height), nbands(std::max(1u, std::min(nthreads, height))),
+		band_rows((height + nbands - 1) / nbands), pixels_(size_t(width)*height) {}
+
+	void set_ball_color(float r, float g, float b, float a = 1) { ball_color = pack(r, g, b, a); }
+	void set_curve_color(float r, float g, float b, float a = 1) { curve_color = pack(r, g, b, a); }
+	void set_background(float r, float g, float b, float a = 0) { background = pack(r, g, b, a); }
+	// the next draw() tessellates the curves again
+	void invalidate() { tessellation.invalidate(); }
+
+	unsigned int width() const { return width_; }
+	unsigned int height() const { return height_; }
+	// width*height RGBA pixels, rows from top to bottom (the layout of sf::Image and VideoStream::push)
+	uint8_t const* pixels() const { return reinterpret_cast<uint8_t const*>(pixels_.data()); }
+
+	// renders the curves of `world` and balls at `positions` (e.g. a recorded snapshot),
+	// the view [view_min, view_max] (world coordinates) spanning the image
+	void draw(World const& world, std::span<vec2 const> positions, vec2 const& view_min, vec2 const& view_max) {
+		View view{view_min, vec2(width_ / (view_max.x - view_min.x), height_ / (view_max.y - view_min.y))};
+		tessellation.update(world, 1/view.scale.x);
+		bin(positions, view);
+		Parallel::for_chunks(nbands, nbands, [&](unsigned int band, size_t, size_t) {
+			unsigned int row_begin(std::min(band*band_rows, height_)), row_end(std::min(row_begin + band_rows, height_));
+			std::fill(pixels_.begin() + size_t(row_begin)*width_, pixels_.begin() + size_t(row_end)*width_, background);
+			for (size_t k(band_begin[band]); k < band_begin[band + 1]; ++k)
+				pixels_[binned[k]] = ball_color;
+			draw_curves(view, row_begin, row_end);
+		});
+	}
+
+	// renders `world`, the view [view_min, view_max] (world coordinates) spanning the image
+	void draw(World const& world, vec2 const& view_min, vec2 const& view_max) {
+		draw(world, world.positions(), view_min, view_max);
+	}
+
+	// renders `world` with the world coordinates [0, width]x[0, height] spanning the image
+	void draw(World const& world) {
+		draw(world, vec2(0, 0), vec2(width_, height_));
+	}
+
+private:
+	static constexpr uint32_t OUTSIDE = UINT32_MAX;
+
+	struct View {
+		vec2 min;
+		vec2 scale;  // pixels per world unit
+	};
+
+	unsigned int width_, height_;
+	unsigned int nbands, band_rows;
+	std::vector<uint32_t> pixels_;
+	uint32_t ball_color = pack(0, 1, 0.5, 1);
+	uint32_t curve_color = pack(0.5, 0.5, 0.5, 1);
+	uint32_t background = pack(0, 0, 0, 0);
+	CurveTessellation tessellation;
+
+	std::vector<uint32_t> cells;  // pixel of each ball, or OUTSIDE
+	std::vector<size_t> counts;  // balls of chunk c in band b, at c*nbands + b, then write offsets
+	std::vector<size_t> band_begin;  // nbands + 1 offsets into `binned`
+	std::vector<uint32_t> binned;  // pixels of the balls, grouped by band
+
+	static uint32_t pack(float r, float g, float b, float a) {
+		uint8_t rgba[4] = {channel(r), channel(g), channel(b), channel(a)};
+		uint32_t ret;
+		std::memcpy(&ret, rgba, sizeof(ret));
+		return ret;
+	}
+
+	static uint8_t channel(float c) {
+		return uint8_t(std::lround(std::clamp(c, 0.f, 1.f) * 255));
+	}
+
+	// groups the pixels of the balls by band, in parallel over the balls
+	void bin(std::span<vec2 const> positions, View const& view) {
+		size_t n(positions.size());
+		unsigned int nchunks(nbands);
+		cells.resize(n);
+		counts.assign(size_t(nchunks)*nbands, 0);
+
+		Parallel::for_chunks(n, nchunks, [&](unsigned int chunk, size_t begin, size_t end) {
+			size_t* count(counts.data() + size_t(chunk)*nbands);
+			for (size_t i(begin); i < end; ++i) {
+				double x((positions[i].x - view.min.x) * view.scale.x);
+				double y((positions[i].y - view.min.y) * view.scale.y);
+				// also rejects NaNs
+				if (!(x >= 0 && x < width_ && y >= 0 && y < height_)) {
+					cells[i] = OUTSIDE;
+					continue;
+				}
+				unsigned int row(height_ - 1 - (unsigned int)(y));
+				cells[i] = row*width_ + (unsigned int)(x);
+				++count[row / band_rows];
+			}
+		});
+
+		// balls of band b are written by chunk 0, then chunk 1, ...
+		band_begin.assign(nbands + 1, 0);
+		size_t offset(0);
+		for (unsigned int band(0); band < nbands; ++band) {
+			band_begin[band] = offset;
+			for (unsigned int chunk(0); chunk < nchunks; ++chunk) {
+				size_t count(counts[size_t(chunk)*nbands + band]);
+				counts[size_t(chunk)*nbands + band] = offset;
+				offset += count;
+			}
+		}
+		band_begin[nbands] = offset;
+		binned.resize(offset);
+
+		Parallel::for_chunks(n, nchunks, [&](unsigned int chunk, size_t begin, size_t end) {
+			size_t* next(counts.data() + size_t(chunk)*nbands);
+			for (size_t i(begin); i < end; ++i)
+				if (cells[i] != OUTSIDE)
+					binned[next[cells[i] / width_ / band_rows]++] = cells[i];
+		});
+	}
+
+	// draws the pixels of the curve strips in rows [row_begin, row_end)
+	void draw_curves(View const& view, unsigned int row_begin, unsigned int row_end) {
+		std::vector<vec2> const& vertices(tessellation.vertices());
+		for (size_t strip(0); strip < tessellation.counts().size(); ++strip) {
+			size_t first(tessellation.firsts()[strip]), count(tessellation.counts()[strip]);
+			for (size_t k(first); k + 1 < first + count; ++k)
+				draw_segment(to_pixels(vertices[k], view), to_pixels(vertices[k + 1], view), row_begin, row_end);
+		}
+	}
+
+	// pixel coordinates, y going up from the bottom of the image
+	static vec2 to_pixels(vec2 const& pos, View const& view) {
+		return vec2((pos.x - view.min.x) * view.scale.x, (pos.y - view.min.y) * view.scale.y);
+	}
+
+	// draws the pixels of segment [a, b) that lie in rows [row_begin, row_end)
+	// one pixel per column (or row, for steep segments), like GL lines: the pixel of `b` is left to the next
+	// segment of the strip. The pixels only depend on the segment, not on the band, so the bands join seamlessly
+	void draw_segment(vec2 const& a, vec2 const& b, unsigned int row_begin, unsigned int row_end) {
+		// the image restricted to the band, in y-up pixel coordinates, with a margin
+		double ymin(double(height_) - row_end - 1), ymax(double(height_) - row_begin + 1);
+		double u0(0), u1(1);
+		vec2 d(b - a);
+		if (!clip(-d.x, a.x + 1, u0, u1) || !clip(d.x, width_ + 1 - a.x, u0, u1)
+			|| !clip(-d.y, a.y - ymin, u0, u1) || !clip(d.y, ymax - a.y, u0, u1))
+			return;
+		vec2 p0(a + d*u0), p1(a + d*u1);
+
+		auto plot = [&](long col, long row_up) {
+			if (col < 0 || col >= long(width_) || row_up < 0 || row_up >= long(height_))
+				return;
+			unsigned int row(height_ - 1 - row_up);
+			if (row >= row_begin && row < row_end)
+				pixels_[size_t(row)*width_ + col] = curve_color;
+		};
+
+		if (std::abs(d.x) >= std::abs(d.y)) {
+			if (d.x == 0)
+				return;
+			auto [first, last] = centres(p0.x, p1.x);
+			for (long col(first); col < last; ++col)
+				plot(col, std::floor(a.y + (col + 0.5 - a.x) * d.y / d.x));
+		} else {
+			auto [first, last] = centres(p0.y, p1.y);
+			for (long row_up(first); row_up < last; ++row_up)
+				plot(std::floor(a.x + (row_up + 0.5 - a.y) * d.x / d.y), row_up);
+		}
+	}
+
+	// pixels [first, last) whose centre k + 0.5 is crossed going from `from` (included) to `to` (excluded)
+	static std::pair<long, long> centres(double from, double to) {
+		if (from < to)
+			return {std::ceil(from - 0.5), std::ceil(to - 0.5)};
+		return {std::floor(to - 0.5) + 1, std::floor(from - 0.5) + 1};
+	}
+
+	// Liang-Barsky clipping of the parameter range [u0, u1] against p*u <= q
+	static bool clip(double p, double q, double& u0, double& u1) {
+		if (p == 0)
+			return q >= 0;
+		double u(q / p);
+		if (p < 0)
+			u0 = std::max(u0, u);
+		else
+			u1 = std::min(u1, u);
+		return u0 <= u1;
+	}
+};
+
+#endif
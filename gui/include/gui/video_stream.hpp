@@ -0,0 +1,192 @@
+#ifndef __VIDEO_STREAM_HPP__
+#define __VIDEO_STREAM_HPP__
+
+#include <cerrno>
+#include <csignal>  // std::signal, SIGPIPE
+#include <cstdint>  // uint8_t, uint64_t
+#include <cstring>  // std::memcpy
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <stdexcept>  // std::runtime_error
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>  // open
+#include <unistd.h>  // write, close
+
+// Streams rendered frames as a YUV4MPEG2 (Y4M) video, to stdout ("-"), a file or a FIFO,
+// so that an encoder consumes them while they are produced, without intermediate images:
+//   ./build/gui/gui world.json --stream-video - | ffmpeg -i - -c:v libx264 -pix_fmt yuv420p out.mp4
+//
+// The stream is 4:4:4 (C444), BT.601 limited range, progressive, with square pixels.
+// Frames are copied into a bounded queue and converted and written by a separate thread. When the encoder
+// is slower than the renderer and the queue is full, push() either blocks (back-pressure) or drops the frame.
+
+class VideoStream {
+public:
+	enum class Overflow {
+		BLOCK,  // wait for the writer, the renderer runs at the speed of the encoder
+		DROP  // discard the frame and count it (real-time rendering)
+	};
+
+	VideoStream(std::string const& path, unsigned int width, unsigned int height, unsigned int fps,
+		size_t capacity = 8, Overflow overflow = Overflow::BLOCK)
+		: width(width), height(height), capacity(capacity == 0 ? 1 : capacity), overflow(overflow) {
+		// a closed pipe is reported by write() instead of killing the process
+		std::signal(SIGPIPE, SIG_IGN);
+		if (path == "-") {
+			fd = STDOUT_FILENO;
+		} else {
+			// opening a FIFO blocks until the encoder opens it for reading
+			fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+			if (fd < 0)
+				throw std::runtime_error("failed to open file `" + path + "`");
+			owns_fd = true;
+		}
+		std::string header("YUV4MPEG2 W" + std::to_string(width) + " H" + std::to_string(height)
+			+ " F" + std::to_string(fps) + ":1 Ip A1:1 C444\n");
+		if (!write_all(header.data(), header.size())) {
+			close_fd();
+			throw std::runtime_error("failed to write video header to `" + path + "`");
+		}
+		writer = std::thread(&VideoStream::run, this);
+	}
+
+	~VideoStream() { close(); }
+
+	// writes the queued frames and closes the stream, later frames are dropped
+	void close() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		not_empty.notify_one();
+		if (writer.joinable())
+			writer.join();
+		close_fd();
+	}
+
+	VideoStream(VideoStream const&) = delete;
+	VideoStream& operator=(VideoStream const&) = delete;
+
+	// queues a copy of a width*height RGBA frame (rows from top to bottom), from a single rendering thread
+	// returns false if the frame was dropped, because the queue was full or the stream failed or was closed
+	bool push(uint8_t const* rgba) {
+		std::vector<uint8_t> frame;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			if (overflow == Overflow::BLOCK)
+				not_full.wait(lock, [&]() { return queue.size() < capacity || failed_ || stopping; });
+			if (failed_ || stopping || queue.size() >= capacity) {
+				++dropped_;
+				return false;
+			}
+			// buffers are recycled, so that streaming does not allocate once the queue is warm
+			if (!pool.empty()) {
+				frame = std::move(pool.back());
+				pool.pop_back();
+			}
+		}
+		frame.resize(size_t(width) * height * 4);
+		std::memcpy(frame.data(), rgba, frame.size());
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			queue.push_back(std::move(frame));
+		}
+		not_empty.notify_one();
+		return true;
+	}
+
+	uint64_t written() const { std::lock_guard<std::mutex> lock(mutex); return written_; }
+	uint64_t dropped() const { std::lock_guard<std::mutex> lock(mutex); return dropped_; }
+	// the reader closed the stream (or writing failed), later frames are dropped
+	bool failed() const { std::lock_guard<std::mutex> lock(mutex); return failed_; }
+
+private:
+	int fd = -1;
+	bool owns_fd = false;
+	unsigned int width, height;
+	size_t capacity;
+	Overflow overflow;
+
+	mutable std::mutex mutex;
+	std::condition_variable not_full, not_empty;
+	std::deque<std::vector<uint8_t>> queue;
+	std::vector<std::vector<uint8_t>> pool;
+	bool stopping = false;
+	bool failed_ = false;
+	uint64_t written_ = 0;
+	uint64_t dropped_ = 0;
+	std::thread writer;
+
+	void close_fd() {
+		if (owns_fd)
+			::close(fd);
+		owns_fd = false;
+	}
+
+	bool write_all(char const* data, size_t n) {
+		while (n > 0) {
+			ssize_t k(::write(fd, data, n));
+			if (k < 0) {
+				if (errno == EINTR)
+					continue;
+				return false;
+			}
+			data += k;
+			n -= k;
+		}
+		return true;
+	}
+
+	// RGBA to planar Y, U, V (BT.601, limited range, integer arithmetic)
+	void convert(std::vector<uint8_t> const& rgba, std::vector<char>& yuv) const {
+		size_t npixels(size_t(width) * height);
+		yuv.resize(6 + 3*npixels);
+		std::memcpy(yuv.data(), "FRAME\n", 6);
+		uint8_t* y(reinterpret_cast<uint8_t*>(yuv.data()) + 6);
+		uint8_t* u(y + npixels);
+		uint8_t* v(u + npixels);
+		for (size_t i(0); i < npixels; ++i) {
+			int r(rgba[4*i]), g(rgba[4*i+1]), b(rgba[4*i+2]);
+			y[i] = uint8_t(((66*r + 129*g + 25*b + 128) >> 8) + 16);
+			u[i] = uint8_t(((-38*r - 74*g + 112*b + 128) >> 8) + 128);
+			v[i] = uint8_t(((112*r - 94*g - 18*b + 128) >> 8) + 128);
+		}
+	}
+
+	// writer thread main loop
+	void run() {
+		std::vector<char> yuv;
+		while (true) {
+			std::vector<uint8_t> frame;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				not_empty.wait(lock, [&]() { return !queue.empty() || stopping; });
+				if (queue.empty())
+					return;
+				frame = std::move(queue.front());
+				queue.pop_front();
+			}
+			not_full.notify_one();
+
+			convert(frame, yuv);
+			bool ok(write_all(yuv.data(), yuv.size()));
+
+			std::lock_guard<std::mutex> lock(mutex);
+			pool.push_back(std::move(frame));
+			if (ok) {
+				++written_;
+			} else {
+				// the remaining frames are lost, and the renderer must not block on a dead stream
+				failed_ = true;
+				dropped_ += 1 + queue.size();
+				queue.clear();
+				not_full.notify_all();
+			}
+		}
+	}
+};
+
+#endif
@@ -0,0 +1,119 @@
+#ifndef __VIEW_PROGRAM_HPP__
+#define __VIEW_PROGRAM_HPP__
+
+#include <SFML/OpenGL.hpp>  // the GL 2.0+ entry points need GL_GLEXT_PROTOTYPES, defined by the build
+#include <stdexcept>  // std::runtime_error
+#include <string>
+#include "physics/vec2.hpp"
+
+// Shader program shared by the retained-mode renderers
+// Vertices are world coordinates relative to an origin (2 doubles, attribute ATTRIBUTE), mapped to clip space
+// by the vertex shader so that the view [view_min, view_max] spans the viewport, and filled with a uniform colour.
+// The GPU converts the vertices to float and maps them in float, so the renderers subtract an origin close to
+// the view in double on the CPU: only coordinates relative to it are rounded, which keeps deep zooms steady.
+// The shaders are GLSL 1.20, so the context must be a compatibility one (SFML's default).
+
+class ViewProgram {
+public:
+	static constexpr GLuint ATTRIBUTE = 0;
+
+	ViewProgram() {
+		program = link(VERTEX_SHADER, FRAGMENT_SHADER, "pos", "view");
+		scale_location = glGetUniformLocation(program, "scale");
+		offset_location = glGetUniformLocation(program, "offset");
+		color_location = glGetUniformLocation(program, "color");
+	}
+
+	~ViewProgram() { glDeleteProgram(program); }
+
+	ViewProgram(ViewProgram const&) = delete;
+	ViewProgram& operator=(ViewProgram const&) = delete;
+
+	// binds the program, sets the uniforms and enables the vertex attribute, the vertices being relative to `origin`
+	void use(vec2 const& view_min, vec2 const& view_max, vec2 const& origin, GLfloat const color[4]) const {
+		// clip = (pos - origin)*scale + offset, the uniforms are computed in double and rounded once
+		vec2 scale(2/(view_max.x - view_min.x), 2/(view_max.y - view_min.y));
+		glUseProgram(program);
+		glUniform2f(scale_location, scale.x, scale.y);
+		glUniform2f(offset_location, -1 - (view_min.x - origin.x)*scale.x, -1 - (view_min.y - origin.y)*scale.y);
+		glUniform4fv(color_location, 1, color);
+		glEnableVertexAttribArray(ATTRIBUTE);
+	}
+
+	// points the vertex attribute at the vec2 array at byte `offset` of the bound GL_ARRAY_BUFFER
+	static void attribute(size_t offset) {
+		glVertexAttribPointer(ATTRIBUTE, 2, GL_DOUBLE, GL_FALSE, sizeof(vec2), reinterpret_cast<void const*>(offset));
+	}
+
+	// leaves the fixed-function state SFML expects
+	static void release() {
+		glDisableVertexAttribArray(ATTRIBUTE);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		glUseProgram(0);
+	}
+
+	// compiles and links a GLSL program whose vertex `attribute` is bound to ATTRIBUTE (also used by the other renderers)
+	static GLuint link(char const* vertex_source, char const* fragment_source, char const* attribute, std::string const& name) {
+		GLuint vertex(compile(GL_VERTEX_SHADER, vertex_source, name));
+		GLuint fragment;
+		try { fragment = compile(GL_FRAGMENT_SHADER, fragment_source, name); }
+		catch (...) { glDeleteShader(vertex); throw; }
+		GLuint program(glCreateProgram());
+		glAttachShader(program, vertex);
+		glAttachShader(program, fragment);
+		glBindAttribLocation(program, ATTRIBUTE, attribute);
+		glLinkProgram(program);
+		glDeleteShader(vertex);
+		glDeleteShader(fragment);
+		GLint ok(GL_FALSE);
+		glGetProgramiv(program, GL_LINK_STATUS, &ok);
+		if (ok != GL_TRUE) {
+			std::string log(info_log(program, glGetProgramiv, glGetProgramInfoLog));
+			glDeleteProgram(program);
+			throw std::runtime_error("failed to link the " + name + " shaders: " + log);
+		}
+		return program;
+	}
+
+private:
+	static constexpr char const* VERTEX_SHADER =
+		"#version 120\n"
+		"attribute vec2 pos;\n"
+		"uniform vec2 scale;\n"
+		"uniform vec2 offset;\n"
+		"void main() { gl_Position = vec4(pos*scale + offset, 0.0, 1.0); }\n";
+
+	static constexpr char const* FRAGMENT_SHADER =
+		"#version 120\n"
+		"uniform vec4 color;\n"
+		"void main() { gl_FragColor = color; }\n";
+
+	GLuint program = 0;
+	GLint scale_location = -1, offset_location = -1, color_location = -1;
+
+	template <typename GetParameter, typename GetLog>
+	static std::string info_log(GLuint object, GetParameter get_parameter, GetLog get_log) {
+		GLint length(0);
+		get_parameter(object, GL_INFO_LOG_LENGTH, &length);
+		std::string log(length > 0 ? length : 0, '\0');
+		if (length > 0)
+			get_log(object, length, nullptr, log.data());
+		return log;
+	}
+
+	static GLuint compile(GLenum type, char const* source, std::string const& name) {
+		GLuint shader(glCreateShader(type));
+		glShaderSource(shader, 1, &source, nullptr);
+		glCompileShader(shader);
+		GLint ok(GL_FALSE);
+		glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+		if (ok != GL_TRUE) {
+			std::string log(info_log(shader, glGetShaderiv, glGetShaderInfoLog));
+			glDeleteShader(shader);
+			throw std::runtime_error("failed to compile the " + name + " shaders: " + log);
+		}
+		return shader;
+	}
+};
+
+#endif
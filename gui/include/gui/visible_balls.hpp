@@ -0,0 +1,183 @@
+#ifndef __VISIBLE_BALLS_HPP__
+#define __VISIBLE_BALLS_HPP__
+
+#include <algorithm>  // std::min, std::max, std::clamp
+#include <cmath>  // std::sqrt, std::floor, std::isfinite
+#include <cstdint>  // uint32_t, UINT32_MAX
+#include <span>
+#include <vector>
+#include "physics/parallel.hpp"
+#include "physics/vec2.hpp"
+
+// Spatial index of the balls, to only upload the balls of a zoomed in view
+// The balls are linked into the cells of a uniform grid of about BALLS_PER_CELL balls per cell (doubly linked lists,
+// threaded through per-ball arrays). query() walks the cells the view intersects, so that its cost follows
+// the number of balls on screen.
+//
+// The index is updated incrementally: every frame the cells of the balls are computed again in parallel,
+// and only the balls that changed cell are moved from a list to another. The grid is only fitted again to
+// the bounding box of the balls when the ball count changes or too many balls have left it.
+// Balls outside of the grid are kept in a list of their own, and always returned.
+
+class VisibleBalls {
+public:
+	static constexpr size_t BALLS_PER_CELL = 16;
+	static constexpr size_t MAX_CELLS = 1 << 22;
+	static constexpr size_t MAX_OUTSIDE = 64;  // the grid is fitted again past n/MAX_OUTSIDE balls outside of it
+
+	explicit VisibleBalls(unsigned int nthreads = Parallel::hardware_threads()) : nthreads(std::max(1u, nthreads)) {}
+
+	// indexes the current `positions`, which must stay valid until the next update
+	void update(std::span<vec2 const> positions) {
+		positions_ = positions;
+		if (positions.size() != nindexed || !move_balls())
+			rebuild();
+		else if (outside_count > positions.size() / MAX_OUTSIDE)
+			rebuild();
+	}
+
+	// positions of the balls in the cells intersecting [view_min, view_max], and of the balls outside of the grid
+	// (the whole span when the view contains the grid)
+	std::span<vec2 const> query(vec2 const& view_min, vec2 const& view_max) {
+		if (view_min.x <= grid_min.x && view_min.y <= grid_min.y
+			&& view_max.x >= grid_min.x + nx/scale.x && view_max.y >= grid_min.y + ny/scale.y)
+			return positions_;
+		visible.clear();
+		double x0((view_min.x - grid_min.x) * scale.x), x1((view_max.x - grid_min.x) * scale.x);
+		double y0((view_min.y - grid_min.y) * scale.y), y1((view_max.y - grid_min.y) * scale.y);
+		if (x1 >= 0 && x0 < nx && y1 >= 0 && y0 < ny) {
+			size_t cx0(std::max(x0, 0.0)), cx1(std::min(x1, nx - 1.0));
+			size_t cy0(std::max(y0, 0.0)), cy1(std::min(y1, ny - 1.0));
+			for (size_t cy(cy0); cy <= cy1; ++cy)
+				for (size_t cx(cx0); cx <= cx1; ++cx)
+					gather(cy*nx + cx);
+		}
+		gather(outside_bucket());
+		return visible;
+	}
+
+	// balls that changed cell in the last update (all of them when the index was rebuilt)
+	size_t moved() const { return moved_; }
+
+private:
+	static constexpr uint32_t NONE = UINT32_MAX;
+
+	unsigned int nthreads;
+	std::span<vec2 const> positions_;
+	size_t nindexed = 0;
+
+	vec2 grid_min;
+	vec2 scale;  // cells per world unit
+	size_t nx = 0, ny = 0;
+
+	std::vector<uint32_t> head;  // first ball of each bucket
+	std::vector<uint32_t> next, prev;  // neighbours of each ball in its bucket
+	std::vector<uint32_t> cells;  // bucket of each ball
+	std::vector<std::vector<uint32_t>> moves;  // balls changing bucket, found by each thread
+	size_t outside_count = 0;
+	size_t moved_ = 0;
+	std::vector<vec2> visible;
+
+	// the grid cells, then the balls outside of it, then the balls that cannot be drawn (NaN)
+	size_t outside_bucket() const { return nx*ny; }
+	size_t invalid_bucket() const { return nx*ny + 1; }
+
+	uint32_t bucket_of(vec2 const& pos) const {
+		double x((pos.x - grid_min.x) * scale.x);
+		double y((pos.y - grid_min.y) * scale.y);
+		if (x >= 0 && x < nx && y >= 0 && y < ny)
+			return size_t(y)*nx + size_t(x);
+		if (std::isfinite(x) && std::isfinite(y))
+			return outside_bucket();
+		return invalid_bucket();
+	}
+
+	void link(uint32_t ball, uint32_t bucket) {
+		cells[ball] = bucket;
+		prev[ball] = NONE;
+		next[ball] = head[bucket];
+		if (head[bucket] != NONE)
+			prev[head[bucket]] = ball;
+		head[bucket] = ball;
+		outside_count += bucket == outside_bucket();
+	}
+
+	void unlink(uint32_t ball) {
+		uint32_t bucket(cells[ball]);
+		if (prev[ball] != NONE)
+			next[prev[ball]] = next[ball];
+		else
+			head[bucket] = next[ball];
+		if (next[ball] != NONE)
+			prev[next[ball]] = prev[ball];
+		outside_count -= bucket == outside_bucket();
+	}
+
+	// finds the balls that changed cell in parallel, then moves them
+	// returns false when so many balls moved that rebuilding is cheaper
+	bool move_balls() {
+		size_t n(positions_.size());
+		unsigned int nchunks(std::max<size_t>(1, std::min<size_t>(nthreads, n / BALLS_PER_CELL)));
+		moves.resize(std::max<size_t>(moves.size(), nchunks));
+		Parallel::for_chunks(n, nchunks, [&](unsigned int chunk, size_t begin, size_t end) {
+			std::vector<uint32_t>& moving(moves[chunk]);
+			moving.clear();
+			for (size_t i(begin); i < end; ++i)
+				if (bucket_of(positions_[i]) != cells[i])
+					moving.push_back(i);
+		});
+		moved_ = 0;
+		for (unsigned int chunk(0); chunk < nchunks; ++chunk)
+			moved_ += moves[chunk].size();
+		if (moved_ > n / 4)
+			return false;
+		for (unsigned int chunk(0); chunk < nchunks; ++chunk) {
+			for (uint32_t ball : moves[chunk]) {
+				unlink(ball);
+				link(ball, bucket_of(positions_[ball]));
+			}
+		}
+		return true;
+	}
+
+	// fits the grid to the bounding box of the balls and links all of them
+	void rebuild() {
+		size_t n(positions_.size());
+		nindexed = n;
+		moved_ = n;
+		vec2 lo(INFINITY, INFINITY), hi(-INFINITY, -INFINITY);
+		for (vec2 const& pos : positions_) {
+			if (!std::isfinite(pos.x) || !std::isfinite(pos.y))
+				continue;
+			lo = vec2(std::min(lo.x, pos.x), std::min(lo.y, pos.y));
+			hi = vec2(std::max(hi.x, pos.x), std::max(hi.y, pos.y));
+		}
+		if (!(lo.x <= hi.x))
+			lo = hi = vec2(0, 0);
+		// square cells, the grid slightly larger than the box so that the balls on its upper edges are inside
+		vec2 extent(std::max(hi.x - lo.x, 1e-9), std::max(hi.y - lo.y, 1e-9));
+		size_t target(std::clamp<size_t>(n / BALLS_PER_CELL, 1, MAX_CELLS));
+		double side(std::sqrt(extent.x * extent.y / target));
+		nx = std::clamp<size_t>(std::floor(extent.x / side) + 1, 1, MAX_CELLS);
+		ny = std::clamp<size_t>(std::floor(extent.y / side) + 1, 1, MAX_CELLS / nx);
+		grid_min = lo;
+		scale = vec2(nx / (extent.x * (1 + 1e-9)), ny / (extent.y * (1 + 1e-9)));
+
+		head.assign(nx*ny + 2, NONE);
+		next.resize(n);
+		prev.resize(n);
+		cells.resize(n);
+		outside_count = 0;
+		// linked in reverse, so that each list is in ball order
+		for (size_t i(n); i-- > 0;)
+			link(i, bucket_of(positions_[i]));
+	}
+
+	// appends the positions of the balls of `bucket`
+	void gather(size_t bucket) {
+		for (uint32_t ball(head[bucket]); ball != NONE; ball = next[ball])
+			visible.push_back(positions_[ball]);
+	}
+};
+
+#endif
@@ -3,63 +3,62 @@
 #include <SFML/OpenGL.hpp>
 
 #include <memory>  // std::make_shared
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
 #include <cmath>
 #include <iostream>
 #include <fstream>
+#include <cstdio>  // std::snprintf
 
 #include "gui/from_json.hpp"
+#include "gui/renderer.hpp"
+#include "gui/software_renderer.hpp"
+#include "gui/density_image.hpp"
+#include "gui/video_stream.hpp"
+#include "gui/frame_budget.hpp"
+#include "gui/visible_balls.hpp"
+#include "gui/snapshots.hpp"
 
 #include "argparse/argparse.hpp"
-#include "json/json.hpp"
 
 #include "physics/world.hpp"
+#include "physics/density.hpp"
 #include "physics/ball.hpp"
 #include "physics/curve.hpp"
 #include "physics/vec2.hpp"
+#include "physics/logger.hpp"
 
 unsigned int WINDOW_WIDTH(1200), WINDOW_HEIGHT(900);
 // unsigned int WINDOW_WIDTH(500), WINDOW_HEIGHT(500);
 
-void draw(World const& world) {
+// draws the view [view_min, view_max] (world coordinates)
+// with a `visible` index, only the balls of the cells in view are uploaded
+void draw(World const& world, BallRenderer& balls, CurveRenderer& curves,
+	vec2 const& view_min, vec2 const& view_max, VisibleBalls* visible = nullptr) {
 	// clear the buffers
 	glClearColor(0.0, 0.0, 0.0, 0.0);
 	glClearDepth(1.0);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-	glClear(GL_COLOR_BUFFER_BIT);
-
-	// draw balls
-	glPointSize(1);
-	glColor3f(0.0, 1.0, 0.5);
-	glBegin(GL_POINTS);
-	for (auto const& ball_ptr : world.ball_ptrs)
-		glVertex2f(ball_ptr->pos.x/(WINDOW_WIDTH/2)-1, (ball_ptr->pos.y)/(WINDOW_HEIGHT/2)-1);
-	glEnd();
-
-	// draw curves
-	glLineWidth(1);
-	glColor3f(0.5, 0.5, 0.5);
-	for (auto const& curve_ptr : world.curve_ptrs) {
-		glBegin(GL_LINE_STRIP);
-		vec2 pt;
-		pt = (*curve_ptr)(0);
-		glVertex2f(pt.x/(WINDOW_WIDTH/2)-1, pt.y/(WINDOW_HEIGHT/2)-1);
-		for (double t : Globals::linspace(0, 1, 100)) {
-			pt = (*curve_ptr)(t);
-			glVertex2f(pt.x/(WINDOW_WIDTH/2)-1, pt.y/(WINDOW_HEIGHT/2)-1);
-		}
-		pt = (*curve_ptr)(1);
-		glVertex2f(pt.x/(WINDOW_WIDTH/2)-1, pt.y/(WINDOW_HEIGHT/2)-1);
-		glEnd();
+
+	// one draw call for all the balls, the positions are transformed by the shader
+	if (visible) {
+		visible->update(world.positions());
+		balls.draw(visible->query(view_min, view_max), view_min, view_max);
+	} else {
+		balls.draw(world.positions(), view_min, view_max);
 	}
-	glFlush();
 
+	// tessellated once, unless the curves or the zoom change
+	curves.draw(world, view_min, view_max, WINDOW_WIDTH);
+	glFlush();
 }
 
 int main(int argc, char const *argv[]) {
 	argparse::ArgumentParser parser("chaotic billiard");
 
 	parser.add_argument("worldfile")
-		.help(".json file containing world information");
+		.help(".json or binary world file (see convert_world) containing world information");
 
 	parser.add_argument("--window")
 		.help("display a render window")
@@ -71,11 +70,57 @@ int main(int argc, char const *argv[]) {
 		.default_value(false)
 		.implicit_value(true);
 
+	parser.add_argument("--headless")
+		.help("render on the CPU, without any GL context or display (with --render or --stream-video)")
+		.default_value(false)
+		.implicit_value(true);
+
+	parser.add_argument("--accumulate")
+		.help("bin the balls after every step, and write the tone-mapped density and the raw histogram to <path>.png and <path>.npy (frames then show the density)")
+		.default_value(std::string());
+
+	parser.add_argument("--record")
+		.help("only simulate, and write the ball positions of every frame to a snapshot file, to render later with --render-from")
+		.default_value(std::string());
+
+	parser.add_argument("--render-from")
+		.help("render the frames of a snapshot file (see --record) on all the CPU cores, with --render or --stream-video")
+		.default_value(std::string());
+
+	parser.add_argument("--stream-video")
+		.help("stream the rendered frames as a Y4M video to a file or FIFO (`-` for stdout, logs then go to stderr)")
+		.default_value(std::string());
+
+	parser.add_argument("--stream-fps")
+		.help("frame rate written in the Y4M header")
+		.scan<'i', int>()
+		.default_value(30);
+
+	parser.add_argument("--stream-queue")
+		.help("number of frames buffered for the video encoder")
+		.scan<'i', int>()
+		.default_value(8);
+
+	parser.add_argument("--stream-drop")
+		.help("drop frames when the video encoder falls behind, instead of waiting for it")
+		.default_value(false)
+		.implicit_value(true);
+
 	parser.add_argument("--adaptative-dt")
 		.help("use a flexible dt determined by framerate")
 		.default_value(false)
 		.implicit_value(true);
 
+	parser.add_argument("--step-budget")
+		.help("milliseconds of stepping per displayed frame in the window, the steps all use the same dt")
+		.scan<'g', double>()
+		.default_value(10.0);
+
+	parser.add_argument("--sim-rate")
+		.help("simulated time per second in the window (within the step budget), 0 to step as much as the budget allows")
+		.scan<'g', double>()
+		.default_value(0.0);
+
 	parser.add_argument("--duration")
 		.help("duration of the simulation")
 		.scan<'g', double>()
@@ -88,109 +133,338 @@ int main(int argc, char const *argv[]) {
 
 	parser.parse_args(argc, argv);
 
+	std::string stream_path(parser.get<std::string>("--stream-video"));
+	if (stream_path == "-")
+		std::cout.rdbuf(std::cerr.rdbuf());  // stdout carries the video
+
 	// Parse world
-	std::ifstream file(parser.get<std::string>("worldfile"));
-	if (!file)
-		throw std::runtime_error("failed to open file `" + parser.get<std::string>("worldfile") + "`");
-	nlohmann::json j;
-	file >> j;
-	World world(World_from_json(j));
-
-	if (parser.get<bool>("--window") || parser.get<bool>("--render")) {
-		sf::RenderTexture texture;
-		texture.setSmooth(false);
-		sf::Sprite sprite;
-		texture.create(WINDOW_WIDTH, WINDOW_HEIGHT);
-
-		unsigned int nsamples(parser.get<int>("--nsamples"));
-		double duration(parser.get<double>("--duration"));
-		double dt(duration/(nsamples-1));
-
-		if (parser.get<bool>("--window")) {
-			// Rendering with a window
-			// TODO : use renderer.hpp SFMLRenderer
-			sf::RenderWindow window(sf::VideoMode(WINDOW_WIDTH, WINDOW_HEIGHT), "chaotic billiard");
-			sf::Clock clock;
-			unsigned int frame_n(0);
-			window.setVerticalSyncEnabled(true);
-
-			while (window.isOpen()) {
-				if (parser.get<bool>("--adaptative-dt")) {
-					// TODO : framerate in window title
-					double frame_dt(clock.restart().asSeconds());
-					std::cout << frame_dt << std::endl;
-					world.step(frame_dt*100);
-				} else {
-					world.step(dt);
-				}
+	LoadStats load_stats;
+	World world(World_from_file(parser.get<std::string>("worldfile"), &load_stats));
+	Logger::info(load_stats.str());
 
-				if (!texture.setActive(true))
-					std::cerr << "Failed to activate RenderTexture" << std::endl;
-				draw(world);
-				texture.display();
-				sprite.setTexture(texture.getTexture());
-				glViewport(0, 0, WINDOW_WIDTH, WINDOW_HEIGHT);
-				if (!texture.setActive(false))
-					std::cerr << "Failed to deactivate RenderTexture" << std::endl;
+	if (parser.get<bool>("--headless") && (parser.get<bool>("--window") || !(parser.get<bool>("--render") || !stream_path.empty()))) {
+		Logger::error("--headless needs --render or --stream-video, and cannot be used with --window");
+		return 1;
+	}
 
-				if (!window.setActive(true))
-					std::cerr << "Failed to activate Window" << std::endl;
-				window.clear();
-				window.draw(sprite);
-				window.display();
-				if (!window.setActive(false))
-					std::cerr << "Failed to deactivate Window" << std::endl;
-
-				sf::Event event;
-				if (window.pollEvent(event)) {
-					if (event.type == sf::Event::Closed)
-						window.close();
-					else if (event.type == sf::Event::Resized) {
-						WINDOW_WIDTH = event.size.width;
-						WINDOW_HEIGHT = event.size.height;
-						glViewport(0, 0, WINDOW_WIDTH, WINDOW_HEIGHT);
+	std::string density_path(parser.get<std::string>("--accumulate"));
+	std::string record_path(parser.get<std::string>("--record"));
+	std::string snapshots_path(parser.get<std::string>("--render-from"));
+
+	unsigned int nsamples(parser.get<int>("--nsamples"));
+	double duration(parser.get<double>("--duration"));
+	double dt(duration/(nsamples-1));
+
+	if (!record_path.empty()) {
+		if (parser.get<bool>("--window") || parser.get<bool>("--render") || !stream_path.empty() || !density_path.empty() || !snapshots_path.empty()) {
+			Logger::error("--record cannot be used with --window, --render, --stream-video, --accumulate or --render-from");
+			return 1;
+		}
+		// Simulation only, the frames are rendered later from the snapshots
+		Snapshots::Writer snapshots(record_path, world.balls.size());
+		for (World::Frame const& frame : world.frames(dt, nsamples))
+			snapshots.write(frame.time, frame.positions);
+		snapshots.close();
+		Logger::info("recorded " + std::to_string(snapshots.nframes()) + " frames into `" + record_path + "`");
+		return 0;
+	}
+
+	if (!snapshots_path.empty() && (parser.get<bool>("--window") || !density_path.empty()
+		|| !(parser.get<bool>("--render") || !stream_path.empty()))) {
+		Logger::error("--render-from needs --render or --stream-video, and cannot be used with --window or --accumulate");
+		return 1;
+	}
+
+	if (parser.get<bool>("--window") || parser.get<bool>("--render") || !stream_path.empty() || !density_path.empty()) {
+		// size of the rendered frames, the window may be resized later
+		unsigned int width(WINDOW_WIDTH), height(WINDOW_HEIGHT);
+
+		// long exposure: the positions are binned after every step, one histogram cell per pixel
+		std::shared_ptr<Density::Accumulator> density;
+		std::vector<uint8_t> density_pixels;
+		float const density_color[3] = {0.0, 1.0, 0.5};
+		if (!density_path.empty()) {
+			density = std::make_shared<Density::Accumulator>(Density::Settings{vec2(0, 0), vec2(width, height), width, height});
+			world.set_density(density);
+			density_pixels.resize(size_t(width)*height*4);
+		}
+		// tone maps the density accumulated so far
+		auto density_frame([&]() {
+			density->merge();
+			DensityImage::tone_map(density->histogram(), width, height, density_pixels.data(), density_color);
+			return density_pixels.data();
+		});
+
+		std::unique_ptr<VideoStream> video;
+		if (!stream_path.empty()) {
+			video = std::make_unique<VideoStream>(stream_path, width, height,
+				parser.get<int>("--stream-fps"), parser.get<int>("--stream-queue"),
+				parser.get<bool>("--stream-drop") ? VideoStream::Overflow::DROP : VideoStream::Overflow::BLOCK);
+		}
+		// saves a width*height RGBA frame (rows from top to bottom), if rendering to files
+		auto save_frame([&](size_t index, uint8_t const* rgba) {
+			if (parser.get<bool>("--render")) {
+				sf::Image image;
+				image.create(width, height, rgba);
+				image.saveToFile("frames/frame" + std::to_string(index) + ".png");
+			}
+		});
+		// streams a width*height RGBA frame, returns false once the reader of the video stream has gone away
+		auto stream_frame([&](uint8_t const* rgba) {
+			if (!video)
+				return true;
+			video->push(rgba);
+			if (video->failed()) {
+				Logger::error("video stream closed by the reader");
+				return false;
+			}
+			return true;
+		});
+		// saves and streams a frame
+		auto output_frame([&](size_t index, uint8_t const* rgba) {
+			save_frame(index, rgba);
+			return stream_frame(rgba);
+		});
+		bool output(parser.get<bool>("--render") || video);
+
+		if (!snapshots_path.empty()) {
+			// Rendering recorded snapshots on the CPU, one frame per thread
+			// the frames are independent, only the video needs them in order
+			Snapshots::Reader snapshots(snapshots_path);
+			unsigned int nthreads(std::min<size_t>(Parallel::hardware_threads(), snapshots.nframes()));
+			std::atomic<size_t> next_frame(0);
+			std::atomic<bool> failed(false);
+			size_t next_output(0);
+			std::mutex mutex;
+			std::condition_variable turn;
+			Parallel::for_chunks(nthreads, nthreads, [&](unsigned int, size_t, size_t) {
+				SoftwareRenderer renderer(width, height, 1);
+				std::vector<vec2> positions(snapshots.nballs());
+				for (size_t k; !failed && (k = next_frame++) < snapshots.nframes();) {
+					try {
+						snapshots.read(k, positions.data());
+						snapshots.release(k);
+						renderer.draw(world, positions, vec2(0, 0), vec2(width, height));
+						save_frame(k, renderer.pixels());
+						if (!video)
+							continue;
+						std::unique_lock<std::mutex> lock(mutex);
+						turn.wait(lock, [&]() { return next_output == k || failed; });
+						if (!failed && !stream_frame(renderer.pixels()))
+							failed = true;
+						++next_output;
+						turn.notify_all();
+					} catch (...) {
+						// frame k never gets its turn, the threads waiting for a later one must not wait forever
+						{
+							std::lock_guard<std::mutex> lock(mutex);
+							failed = true;
+						}
+						turn.notify_all();
+						throw;
 					}
 				}
+			});
+			Logger::info("rendered " + std::to_string(std::min<size_t>(next_frame, snapshots.nframes())) + " frames from `"
+				+ snapshots_path + "` on " + std::to_string(nthreads) + " threads");
+		}
 
-				if (parser.get<bool>("--render")) {
-					texture.getTexture().copyToImage().saveToFile("frames/frame" + std::to_string(frame_n) + ".png");
+		else if (parser.get<bool>("--headless") || (density && !parser.get<bool>("--window"))) {
+			// Rendering on the CPU, without any GL context or display
+			SoftwareRenderer renderer(width, height);
+			for (World::Frame const& frame : world.frames(dt, nsamples)) {
+				if (!output)
+					continue;  // only accumulating
+				uint8_t const* rgba(density_pixels.data());
+				if (density) {
+					density_frame();
+				} else {
+					renderer.draw(world);
+					rgba = renderer.pixels();
 				}
-
-				++frame_n;
+				if (!output_frame(frame.index, rgba))
+					break;
 			}
 		}
 
-		else if (parser.get<bool>("--render")) {
+		else {
+			sf::RenderTexture texture;
+			texture.setSmooth(false);
+			sf::Sprite sprite;
+			texture.create(width, height);
+			// the GL objects of the renderer are shared by the texture and window contexts
 			if (!texture.setActive(true))
 				std::cerr << "Failed to activate RenderTexture" << std::endl;
+			BallRenderer balls;
+			CurveRenderer curves;
+			sf::Texture density_texture;
+			if (density)
+				density_texture.create(width, height);
+
+			if (parser.get<bool>("--window")) {
+				// Rendering with a window
+				// TODO : use renderer.hpp SFMLRenderer
+				sf::RenderWindow window(sf::VideoMode(WINDOW_WIDTH, WINDOW_HEIGHT), "chaotic billiard");
+				sf::Clock clock;
+				unsigned int frame_n(0);
+				window.setVerticalSyncEnabled(true);
+
+				// view of the window, panned by dragging and zoomed with the mouse wheel, reset with R
+				vec2 const home_min(0, 0), home_max(WINDOW_WIDTH, WINDOW_HEIGHT);
+				vec2 view_min(home_min), view_max(home_max);
+				VisibleBalls visible;
+				bool dragging(false);
+				int drag_x(0), drag_y(0);
+				// world coordinates under the window pixel (x, y)
+				auto to_world([&](int x, int y) {
+					double fx(double(x) / window.getSize().x), fy(1 - double(y) / window.getSize().y);
+					return vec2(view_min.x + fx*(view_max.x - view_min.x), view_min.y + fy*(view_max.y - view_min.y));
+				});
+
+				// the simulation runs at its own rate, several fixed dt steps per displayed frame
+				FrameBudget budget(FrameBudget::Settings{dt, parser.get<double>("--step-budget")/1000, parser.get<double>("--sim-rate")});
+				sf::Clock step_clock, draw_clock, title_clock;
+				unsigned long title_steps(0);
+				unsigned int title_frames(0);
+				double title_draw(0);
+
+				while (window.isOpen()) {
+					unsigned int nsteps(1);
+					if (parser.get<bool>("--adaptative-dt")) {
+						world.step(clock.restart().asSeconds()*100);
+					} else {
+						nsteps = budget.plan(clock.restart().asSeconds());
+						step_clock.restart();
+						for (unsigned int i(0); i < nsteps; ++i)
+							world.step(dt);
+						budget.record(nsteps, step_clock.getElapsedTime().asSeconds());
+					}
+					title_steps += nsteps;
+
+					draw_clock.restart();
+					if (density) {
+						density_texture.update(density_frame());
+						sprite.setTexture(density_texture);
+					} else {
+						if (!texture.setActive(true))
+							std::cerr << "Failed to activate RenderTexture" << std::endl;
+						bool home(view_min == home_min && view_max == home_max);
+						draw(world, balls, curves, view_min, view_max, home ? nullptr : &visible);
+						texture.display();
+						sprite.setTexture(texture.getTexture());
+						glViewport(0, 0, WINDOW_WIDTH, WINDOW_HEIGHT);
+						if (!texture.setActive(false))
+							std::cerr << "Failed to deactivate RenderTexture" << std::endl;
+					}
+
+					if (!window.setActive(true))
+						std::cerr << "Failed to activate Window" << std::endl;
+					window.clear();
+					window.draw(sprite);
+					// not waiting for the vertical sync
+					title_draw += draw_clock.getElapsedTime().asSeconds();
+					++title_frames;
+					window.display();
+					if (!window.setActive(false))
+						std::cerr << "Failed to deactivate Window" << std::endl;
+
+					sf::Event event;
+					while (window.pollEvent(event)) {
+						if (event.type == sf::Event::Closed)
+							window.close();
+						else if (event.type == sf::Event::Resized) {
+							WINDOW_WIDTH = event.size.width;
+							WINDOW_HEIGHT = event.size.height;
+							glViewport(0, 0, WINDOW_WIDTH, WINDOW_HEIGHT);
+						}
+						else if (event.type == sf::Event::MouseWheelScrolled) {
+							// zoom around the point under the cursor
+							vec2 center(to_world(event.mouseWheelScroll.x, event.mouseWheelScroll.y));
+							double factor(std::pow(1.25, -event.mouseWheelScroll.delta));
+							view_min = center + (view_min - center)*factor;
+							view_max = center + (view_max - center)*factor;
+						}
+						else if (event.type == sf::Event::MouseButtonPressed && event.mouseButton.button == sf::Mouse::Left) {
+							dragging = true;
+							drag_x = event.mouseButton.x;
+							drag_y = event.mouseButton.y;
+						}
+						else if (event.type == sf::Event::MouseButtonReleased && event.mouseButton.button == sf::Mouse::Left)
+							dragging = false;
+						else if (event.type == sf::Event::MouseMoved && dragging) {
+							vec2 shift(to_world(drag_x, drag_y) - to_world(event.mouseMove.x, event.mouseMove.y));
+							view_min += shift;
+							view_max += shift;
+							drag_x = event.mouseMove.x;
+							drag_y = event.mouseMove.y;
+						}
+						else if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::R) {
+							view_min = home_min;
+							view_max = home_max;
+						}
+					}
+
+					if (output) {
+						sf::Image image;
+						if (!density)
+							image = texture.getTexture().copyToImage();
+						if (!output_frame(frame_n, density ? density_pixels.data() : image.getPixelsPtr()))
+							window.close();
+					}
+
+					if (title_clock.getElapsedTime().asSeconds() >= 0.5) {
+						double elapsed(title_clock.restart().asSeconds());
+						char title[128];
+						std::snprintf(title, sizeof(title), "chaotic billiard | %.0f steps/s | %.3g ball-steps/s | draw %.1f ms",
+							title_steps/elapsed, double(title_steps)*world.balls.size()/elapsed, 1000*title_draw/title_frames);
+						window.setTitle(title);
+						title_steps = 0;
+						title_frames = 0;
+						title_draw = 0;
+					}
 
-			// Rendering without a window
-			unsigned int nsamples(parser.get<int>("--nsamples"));
-			double duration(parser.get<double>("--duration"));
-			double dt(duration/(nsamples-1));
-			double t(0);  // keep track of time to account for inaccuracies
+					++frame_n;
+				}
+			}
 
-			unsigned int frame_n(0);
+			else {
+				if (!texture.setActive(true))
+					std::cerr << "Failed to activate RenderTexture" << std::endl;
 
-			// for (; frame_n < nsamples-1; ++frame_n) {
-			for (; frame_n < nsamples; ++frame_n) {
-				t += dt;
-				world.step(dt);
+				// Rendering without a window
+				// the world is stepped lazily, each time the next frame is pulled
+				for (World::Frame const& frame : world.frames(dt, nsamples)) {
+					draw(world, balls, curves, vec2(0, 0), vec2(WINDOW_WIDTH, WINDOW_HEIGHT));
+					texture.display();
+					glViewport(0, 0, WINDOW_WIDTH, WINDOW_HEIGHT);
+					if (output && !output_frame(frame.index, texture.getTexture().copyToImage().getPixelsPtr()))
+						break;
+				}
+				// TODO : stepping backwards seems to mess up quite a few things
+				// world.step(duration-world.time);  // step the exact remaining time
+				// texture.clear();
+				// draw(world);
+				// texture.display();
+				// texture.getTexture().copyToImage().saveToFile("frames/frame" + std::to_string(nsamples) + ".png");
 
-				draw(world);
-				texture.display();
-				texture.getTexture().copyToImage().saveToFile("frames/frame" + std::to_string(frame_n) + ".png");
-				glViewport(0, 0, WINDOW_WIDTH, WINDOW_HEIGHT);
+				if (!texture.setActive(false))
+					std::cerr << "Failed to deactivate RenderTexture" << std::endl;
 			}
-			// TODO : stepping backwards seems to mess up quite a few things
-			// world.step(duration-t);  // step the exact remaining time
-			// texture.clear();
-			// draw(world);
-			// texture.display();
-			// texture.getTexture().copyToImage().saveToFile("frames/frame" + std::to_string(frame_n) + ".png");
-
-			if (!texture.setActive(false))
-				std::cerr << "Failed to deactivate RenderTexture" << std::endl;
+			texture.setActive(true);  // the vertex buffers are released in the texture context
+		}
+
+		if (video) {
+			video->close();  // writes the queued frames
+			Logger::info("streamed " + std::to_string(video->written()) + " frames, dropped " + std::to_string(video->dropped()));
+		}
+
+		if (density) {
+			sf::Image image;
+			image.create(width, height, density_frame());
+			image.saveToFile(density_path + ".png");
+			density->save_npy(density_path + ".npy");
+			Logger::info("accumulated the density over " + std::to_string(density->steps()) + " steps into `"
+				+ density_path + ".png` and `" + density_path + ".npy`");
 		}
 	}
 
@@ -0,0 +1,44 @@
+#include <string>
+
+#include "gui/from_json.hpp"
+
+#include "argparse/argparse.hpp"
+
+#include "physics/world.hpp"
+#include "physics/worldfile.hpp"
+#include "physics/logger.hpp"
+
+// Converts world files between the JSON and the binary (memory-mappable) formats
+// The input format is detected from the file contents, the output format from the extension of the output file
+
+static bool ends_with(std::string const& str, std::string const& suffix) {
+	return str.size() >= suffix.size() && str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+int main(int argc, char const *argv[]) {
+	argparse::ArgumentParser parser("convert_world");
+
+	parser.add_argument("input")
+		.help(".json or binary world file to read");
+
+	parser.add_argument("output")
+		.help("world file to write, in JSON if it ends with .json, in the binary format otherwise (.cbw)");
+
+	parser.parse_args(argc, argv);
+
+	std::string input(parser.get<std::string>("input"));
+	std::string output(parser.get<std::string>("output"));
+
+	LoadStats load_stats;
+	World world(World_from_file(input, &load_stats));
+	Logger::info(load_stats.str());
+
+	if (ends_with(output, ".json")) {
+		world.write_json(output);
+	} else {
+		WorldFile::save(world, output);
+	}
+	Logger::info("wrote `" + output + "`");
+
+	return 0;
+}
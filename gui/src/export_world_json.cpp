@@ -1,71 +1,73 @@
-#include <fstream>
 #include <string>
 #include <memory>
 #include <random>
+#include <vector>
 
 #include "world.hpp"
 #include "ball.hpp"
+#include "ball_generator.hpp"
+#include "json_writer.hpp"
 #include "curve.hpp"
 #include "vec2.hpp"
 #include "globals.h"
 
-void save(std::string const& filename, World const& world) {
-	std::ofstream file;
-	file.open(filename);
-	file << world.json() << std::endl;
-	file.close();
+typedef std::vector<std::shared_ptr<BallGenerator>> BallGenerators;
+
+// the balls of the world files are described by generators, which the loader expands
+void save(std::string const& filename, World const& world, BallGenerators const& generators) {
+	JsonWriter out(filename);
+	out.raw('{');
+	world.write_json_sections(out);
+	out.raw(",\"generators\":[");
+	for (size_t i(0); i < generators.size(); ++i) {
+		if (i > 0)
+			out.raw(',');
+		out.raw(generators[i]->json());
+	}
+	out.raw("]}\n");
+	out.flush();
 }
 
 int main() {
 	World world;
+	double const corner(250-std::sin(M_PI/4)*200);
 
 	world = World();
 	world.add_curve(std::make_shared<Arc>(vec2(250, 250), 200, 0, 2*M_PI));
-	for (double y : Globals::linspace(51, 449, 100000))
-		world.add_ball(std::make_shared<Ball>(vec2(250, y), vec2(1, 0)));
-	save("world_circle.json", world);
+	save("world_circle.json", world, {std::make_shared<LineGenerator>(vec2(250, 51), vec2(250, 449), vec2(1, 0), 100000)});
 
 	world = World();
 	world.add_curve(std::make_shared<Arc>(vec2(250, 250), 200, 0, 2*M_PI));
-	for (double angle : Globals::linspace(0, 2*M_PI, 50000))
-		world.add_ball(std::make_shared<Ball>(vec2(300, 250), vec2(std::cos(angle), std::sin(angle))));
-	save("world_circle2.json", world);
+	save("world_circle2.json", world, {std::make_shared<FanGenerator>(vec2(300, 250), 0, 2*M_PI, 1, 50000)});
 
 	world = World();
 	world.add_curve(std::make_shared<Arc>(vec2(250, 250), 200, 0, 2*M_PI));
-	for (double x : Globals::linspace(250-std::sin(M_PI/4)*200+1e-10, 250+std::sin(M_PI/4)*200-1e-10, 1000)) {
-		world.add_ball(std::make_shared<Ball>(vec2(x, 250-std::sin(M_PI/4)*200), vec2(1, 0)));
-		world.add_ball(std::make_shared<Ball>(vec2(250-std::sin(M_PI/4)*200, x), vec2(1, 0)));
-	}
-	save("world_circle3.json", world);
+	save("world_circle3.json", world, {
+		std::make_shared<LineGenerator>(vec2(corner+1e-10, corner), vec2(500-corner-1e-10, corner), vec2(1, 0), 1000),
+		std::make_shared<LineGenerator>(vec2(corner, corner+1e-10), vec2(corner, 500-corner-1e-10), vec2(1, 0), 1000)
+	});
 
 	world = World();
 	world.add_curve(std::make_shared<Arc>(vec2(250, 250), 200, 0, 2*M_PI));
-	for (double x : Globals::linspace(250-std::sin(M_PI/4)*200+1e-10, 250+std::sin(M_PI/4)*200-1e-10, 1000)) {
-		world.add_ball(std::make_shared<Ball>(vec2(x, 250-std::sin(M_PI/4)*200), vec2(1, 0)));
-		world.add_ball(std::make_shared<Ball>(vec2(250-std::sin(M_PI/4)*200, x), vec2(0, -1)));
-	}
-	for (double y : Globals::linspace(51, 449, 10000))
-		world.add_ball(std::make_shared<Ball>(vec2(250, y), vec2(1, 0)));
-	save("world_circle4.json", world);
+	save("world_circle4.json", world, {
+		std::make_shared<LineGenerator>(vec2(corner+1e-10, corner), vec2(500-corner-1e-10, corner), vec2(1, 0), 1000),
+		std::make_shared<LineGenerator>(vec2(corner, corner+1e-10), vec2(corner, 500-corner-1e-10), vec2(0, -1), 1000),
+		std::make_shared<LineGenerator>(vec2(250, 51), vec2(250, 449), vec2(1, 0), 10000)
+	});
 
 	world = World();
 	world.add_curve(std::make_shared<Arc>(vec2(150, 250), 100, M_PI/2, 3*M_PI/2));
 	world.add_curve(std::make_shared<Arc>(vec2(350, 250), 100, 3*M_PI/2, M_PI/2));
 	world.add_curve(std::make_shared<Segment>(vec2(150, 150), vec2(350, 150)));
 	world.add_curve(std::make_shared<Segment>(vec2(150, 350), vec2(350, 350)));
-	for (double angle : Globals::linspace(0, 2*M_PI, 10000))
-		world.add_ball(std::make_shared<Ball>(vec2(250, 250), vec2(std::cos(angle), std::sin(angle))));
-	save("world_capsule.json", world);
+	save("world_capsule.json", world, {std::make_shared<FanGenerator>(vec2(250, 250), 0, 2*M_PI, 1, 10000)});
 
 	world = World();
 	world.add_curve(std::make_shared<Segment>(vec2(50, 50), vec2(450, 50)));
 	world.add_curve(std::make_shared<Segment>(vec2(450, 50), vec2(450, 450)));
 	world.add_curve(std::make_shared<Segment>(vec2(450, 450), vec2(50, 450)));
 	world.add_curve(std::make_shared<Segment>(vec2(50, 450), vec2(50, 50)));
-	for (double angle : Globals::linspace(0, 2*M_PI, 100000))
-		world.add_ball(std::make_shared<Ball>(vec2(250, 250), vec2(std::cos(angle), std::sin(angle))));
-	save("world_square.json", world);
+	save("world_square.json", world, {std::make_shared<FanGenerator>(vec2(250, 250), 0, 2*M_PI, 1, 100000)});
 
 	world = World();
 	world.add_curve(std::make_shared<Segment>(vec2(50, 50), vec2(450, 50)));
@@ -73,9 +75,7 @@ int main() {
 	world.add_curve(std::make_shared<Segment>(vec2(450, 450), vec2(50, 450)));
 	world.add_curve(std::make_shared<Segment>(vec2(50, 450), vec2(50, 50)));
 	world.add_curve(std::make_shared<Arc>(vec2(250, 250), 50, 0, 2*M_PI));
-	for (double angle : Globals::linspace(-0.1, 0.1, 10000))
-		world.add_ball(std::make_shared<Ball>(vec2(350, 250), vec2(std::cos(angle), std::sin(angle))));
-	save("world_sinai.json", world);
+	save("world_sinai.json", world, {std::make_shared<FanGenerator>(vec2(350, 250), -0.1, 0.1, 1, 10000)});
 
 	world = World();
 	world.add_curve(std::make_shared<Segment>(vec2(50, 50), vec2(450, 50)));
@@ -92,9 +92,7 @@ int main() {
 		double R = std::abs(rrad(rng));
 		world.add_curve(std::make_shared<Arc>(vec2(X, Y), R, 0, 2*M_PI));
 	}
-	for (double angle : Globals::linspace(M_PI/2, M_PI, 20000))
-		world.add_ball(std::make_shared<Ball>(vec2(449, 51), vec2(std::cos(angle), std::sin(angle))));
-	save("world_pinball.json", world);
+	save("world_pinball.json", world, {std::make_shared<FanGenerator>(vec2(449, 51), M_PI/2, M_PI, 1, 20000)});
 
 	world = World();
 	world.add_curve(std::make_shared<Segment>(vec2(500, 100), vec2(800, 200)));
@@ -112,15 +110,10 @@ int main() {
 	world.add_curve(std::make_shared<Segment>(vec2(1150, 700), vec2(1150, 500)));
 	world.add_curve(std::make_shared<Arc>(vec2(1000, 500), 150, M_PI, 2*M_PI));
 	world.add_curve(std::make_shared<Arc>(vec2(1000, 200), 100, 0, 2*M_PI));
-	for (double angle : Globals::linspace(0, 2*M_PI, 1000)) {
-		world.add_ball(std::make_shared<Ball>(vec2(250, 250), vec2(std::cos(angle), std::sin(angle))));
-		world.add_ball(std::make_shared<Ball>(vec2(600, 250), vec2(std::cos(angle), std::sin(angle))));
-		world.add_ball(std::make_shared<Ball>(vec2(420, 650), vec2(std::cos(angle), std::sin(angle))));
-		world.add_ball(std::make_shared<Ball>(vec2(420, 820), vec2(std::cos(angle), std::sin(angle))));
-		world.add_ball(std::make_shared<Ball>(vec2(1000, 600), vec2(std::cos(angle), std::sin(angle))));
-		world.add_ball(std::make_shared<Ball>(vec2(1050, 200), vec2(std::cos(angle), std::sin(angle))));
-	}
-	save("world_debug.json", world);
+	BallGenerators fans;
+	for (vec2 const& p0 : {vec2(250, 250), vec2(600, 250), vec2(420, 650), vec2(420, 820), vec2(1000, 600), vec2(1050, 200)})
+		fans.push_back(std::make_shared<FanGenerator>(p0, 0, 2*M_PI, 1, 1000));
+	save("world_debug.json", world, fans);
 
 	return 0;
 }
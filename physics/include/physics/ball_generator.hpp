@@ -0,0 +1,98 @@
+#ifndef __BALL_GENERATOR_HPP__
+#define __BALL_GENERATOR_HPP__
+
+#include "vec2.hpp"
+#include "balls.hpp"
+#include <cstdint>  // uint64_t
+#include <cstddef>  // size_t
+#include <string>  // std::string
+
+// Procedural ball generators
+// A generator describes a sequence of balls in a few parameters, so that world files do not need to list them.
+// Ball i only depends on i and the parameters, so the sequence is expanded in parallel
+// and gives the same balls whatever the number of threads.
+
+class BallGenerator {
+public:
+	virtual ~BallGenerator() = default;
+
+	// number of balls in the sequence
+	virtual size_t size() const = 0;
+	// writes balls [begin, end) of the sequence to pos[0, end-begin) and vel[0, end-begin)
+	virtual void generate(size_t begin, size_t end, vec2* pos, vec2* vel) const = 0;
+
+	virtual std::string str() const = 0;
+	virtual std::string json() const = 0;
+
+	// appends the whole sequence to `balls`, in parallel for large sequences
+	void append(Balls& balls) const;
+};
+
+class LineGenerator : public BallGenerator {
+public:
+	// n balls evenly spaced from p1 to p2 (both included), all with velocity vel
+	vec2 p1, p2, vel;
+	size_t n;
+
+	LineGenerator(vec2 const& p1_, vec2 const& p2_, vec2 const& vel_, size_t n_) : p1(p1_), p2(p2_), vel(vel_), n(n_) {}
+
+	virtual size_t size() const override { return n; }
+	virtual void generate(size_t begin, size_t end, vec2* pos, vec2* vel) const override;
+
+	virtual std::string str() const override;
+	virtual std::string json() const override;
+};
+
+class FanGenerator : public BallGenerator {
+public:
+	// n balls at p0, with evenly spaced directions from angle_min to angle_max (both included)
+	vec2 p0;
+	double angle_min, angle_max, speed;
+	size_t n;
+
+	FanGenerator(vec2 const& p0_, double angle_min_, double angle_max_, double speed_, size_t n_)
+		: p0(p0_), angle_min(angle_min_), angle_max(angle_max_), speed(speed_), n(n_) {}
+
+	virtual size_t size() const override { return n; }
+	virtual void generate(size_t begin, size_t end, vec2* pos, vec2* vel) const override;
+
+	virtual std::string str() const override;
+	virtual std::string json() const override;
+};
+
+class GridGenerator : public BallGenerator {
+public:
+	// nx*ny balls on a regular grid spanning [pmin, pmax] (borders included), row by row, all with velocity vel
+	vec2 pmin, pmax, vel;
+	size_t nx, ny;
+
+	GridGenerator(vec2 const& pmin_, vec2 const& pmax_, vec2 const& vel_, size_t nx_, size_t ny_)
+		: pmin(pmin_), pmax(pmax_), vel(vel_), nx(nx_), ny(ny_) {}
+
+	virtual size_t size() const override { return nx*ny; }
+	virtual void generate(size_t begin, size_t end, vec2* pos, vec2* vel) const override;
+
+	virtual std::string str() const override;
+	virtual std::string json() const override;
+};
+
+class UniformGenerator : public BallGenerator {
+public:
+	// n balls sampled uniformly in phase space: positions in [pmin, pmax], directions in [0, 2pi), all with the same speed
+	// the samples are drawn from a counter-based generator, ball i only depends on `seed` and i
+	vec2 pmin, pmax;
+	double speed;
+	size_t n;
+	uint64_t seed;
+
+	UniformGenerator(vec2 const& pmin_, vec2 const& pmax_, double speed_, size_t n_, uint64_t seed_ = 0)
+		: pmin(pmin_), pmax(pmax_), speed(speed_), n(n_), seed(seed_) {}
+
+	virtual size_t size() const override { return n; }
+	virtual void generate(size_t begin, size_t end, vec2* pos, vec2* vel) const override;
+
+	virtual std::string str() const override;
+	virtual std::string json() const override;
+};
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef __BALLS_HPP__
+#define __BALLS_HPP__
+
+#include "vec2.hpp"
+#include "ball.hpp"
+#include "column.hpp"
+#include <cstddef>  // size_t
+
+// Structure-of-arrays storage of the balls of a World
+// Each column is contiguous, so the stepping loop streams through memory
+// and the positions can be handed to renderers or numpy without any conversion.
+// The columns may borrow memory-mapped data (see worldfile.hpp) until the number of balls changes
+
+class Balls {
+public:
+	Column<vec2> pos, pos_prev, vel;
+
+	Balls() = default;
+
+	size_t size() const { return pos.size(); }
+	bool empty() const { return pos.empty(); }
+
+	void reserve(size_t n) {
+		pos.reserve(n);
+		pos_prev.reserve(n);
+		vel.reserve(n);
+	}
+
+	void resize(size_t n) {
+		pos.resize(n);
+		pos_prev.resize(n);
+		vel.resize(n);
+	}
+
+	void clear() {
+		pos.clear();
+		pos_prev.clear();
+		vel.clear();
+	}
+
+	void push_back(Ball const& ball) {
+		pos.push_back(ball.pos);
+		pos_prev.push_back(ball.pos_prev);
+		vel.push_back(ball.vel);
+	}
+
+	void push_back(vec2 const& pos_, vec2 const& vel_) {
+		pos.push_back(pos_);
+		pos_prev.push_back(pos_);
+		vel.push_back(vel_);
+	}
+
+	// appends `n` balls, their previous positions are `pos_prev_`, or their positions if null
+	void append(vec2 const* pos_, vec2 const* vel_, size_t n, vec2 const* pos_prev_ = nullptr) {
+		pos.append(pos_, n);
+		pos_prev.append(pos_prev_ != nullptr ? pos_prev_ : pos_, n);
+		vel.append(vel_, n);
+	}
+
+	// copy of the i-th ball
+	Ball get(size_t i) const {
+		Ball ball(pos[i], vel[i]);
+		ball.pos_prev = pos_prev[i];
+		return ball;
+	}
+
+	void set(size_t i, Ball const& ball) {
+		pos[i] = ball.pos;
+		pos_prev[i] = ball.pos_prev;
+		vel[i] = ball.vel;
+	}
+};
+
+#endif
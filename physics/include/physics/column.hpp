@@ -0,0 +1,123 @@
+#ifndef __COLUMN_HPP__
+#define __COLUMN_HPP__
+
+#include <vector>
+#include <memory>  // std::shared_ptr
+#include <utility>  // std::move
+#include <cstddef>  // size_t
+
+// Contiguous array that either owns its elements, or borrows them from memory owned by someone else
+// (for instance a memory-mapped world file). Borrowed elements are used in place; the first operation
+// that changes the size copies them into owned storage.
+
+template <typename T>
+class Column {
+	std::vector<T> owned;
+	T* ptr = nullptr;
+	size_t n = 0;
+	std::shared_ptr<void> keepalive;  // owner of the borrowed elements, null when owning
+
+	void sync() {
+		ptr = owned.data();
+		n = owned.size();
+	}
+
+	void detach() {
+		if (!keepalive)
+			return;
+		owned.assign(ptr, ptr + n);
+		keepalive.reset();
+		sync();
+	}
+
+public:
+	typedef T value_type;
+	typedef T* iterator;
+	typedef T const* const_iterator;
+
+	Column() = default;
+	explicit Column(size_t size) : owned(size) { sync(); }
+
+	// copies always own their elements
+	Column(Column const& other) : owned(other.begin(), other.end()) { sync(); }
+	Column& operator=(Column const& other) {
+		if (this != &other) {
+			owned.assign(other.begin(), other.end());
+			keepalive.reset();
+			sync();
+		}
+		return *this;
+	}
+
+	// moving a std::vector keeps its elements in place, so ptr stays valid
+	Column(Column&& other) noexcept
+		: owned(std::move(other.owned)), ptr(other.ptr), n(other.n), keepalive(std::move(other.keepalive)) {
+		other.ptr = nullptr;
+		other.n = 0;
+	}
+	Column& operator=(Column&& other) noexcept {
+		if (this != &other) {
+			owned = std::move(other.owned);
+			ptr = other.ptr;
+			n = other.n;
+			keepalive = std::move(other.keepalive);
+			other.ptr = nullptr;
+			other.n = 0;
+		}
+		return *this;
+	}
+
+	// use the `size` elements at `data` in place, `owner` keeps them alive
+	void borrow(T* data, size_t size, std::shared_ptr<void> owner) {
+		owned.clear();
+		owned.shrink_to_fit();
+		ptr = data;
+		n = size;
+		keepalive = std::move(owner);
+	}
+	bool borrowed() const { return bool(keepalive); }
+
+	size_t size() const { return n; }
+	bool empty() const { return n == 0; }
+	T* data() { return ptr; }
+	T const* data() const { return ptr; }
+	T& operator[](size_t i) { return ptr[i]; }
+	T const& operator[](size_t i) const { return ptr[i]; }
+	T* begin() { return ptr; }
+	T* end() { return ptr + n; }
+	T const* begin() const { return ptr; }
+	T const* end() const { return ptr + n; }
+
+	void push_back(T const& value) {
+		detach();
+		owned.push_back(value);
+		sync();
+	}
+
+	void reserve(size_t capacity) {
+		detach();
+		owned.reserve(capacity);
+		sync();
+	}
+
+	// appends the `count` elements at `values`
+	void append(T const* values, size_t count) {
+		detach();
+		owned.insert(owned.end(), values, values + count);
+		sync();
+	}
+
+	void resize(size_t size) {
+		detach();
+		owned.resize(size);
+		sync();
+	}
+
+	void clear() {
+		keepalive.reset();
+		owned.clear();
+		sync();
+	}
+};
+
+#endif
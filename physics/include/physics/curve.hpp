@@ -218,7 +218,7 @@ public:
 		ss.precision(17);
 		ss
 			<< "{"
-				<< "\"class\":" << "\"Arc\"" << ","
+				<< "\"class\":" << "\"Ellipse\"" << ","
 				<< "\"parameters\":"
 				<< "{"
 					<< "\"p0\":" << p0.json() << ","
@@ -0,0 +1,59 @@
+#ifndef __DENSITY_HPP__
+#define __DENSITY_HPP__
+
+#include "vec2.hpp"
+#include <cstdint>  // uint64_t
+#include <cstddef>  // size_t
+#include <string>  // std::string
+#include <vector>  // std::vector
+
+// Long-exposure density of the balls
+// Every step, the positions of all the balls are binned into a histogram over [grid_min, grid_max],
+// so that a long run converges to the invariant density without storing any frame.
+// Each stepping thread bins into its own histogram, the partial histograms are folded into the totals by merge(),
+// typically once per rendered frame. The partials are double precision, as merge() may only run at the end of a long
+// run: counts stay exact up to 2^53 per cell.
+
+namespace Density {
+	struct Settings {
+		vec2 grid_min, grid_max;
+		size_t nx = 0, ny = 0;
+		// samples weigh the duration of their step (time density) instead of 1 (counts)
+		bool weight_by_dt = false;
+	};
+
+	class Accumulator {
+	public:
+		explicit Accumulator(Settings const& settings);
+
+		Settings const& settings() const { return settings_; }
+
+		// called by the World before stepping
+		void prepare(unsigned int nthreads);
+		// called concurrently by the stepping threads, each with its own `thread` index
+		void sample(unsigned int thread, vec2 const* pos, size_t n, double dt);
+		// called by the World after stepping
+		void end_step() { ++steps_; }
+
+		// folds the partial histograms into the totals, in thread order
+		void merge();
+		// clears the totals and the partial histograms
+		void reset();
+
+		uint64_t steps() const { return steps_; }
+		// merged totals (up to the last merge), row-major (ny, nx), row 0 at grid_min.y
+		std::vector<double> const& histogram() const { return totals; }
+		// sum of the merged histogram
+		double total() const;
+		// writes the merged histogram as a (ny, nx) float64 NumPy .npy file
+		void save_npy(std::string const& filepath) const;
+
+	private:
+		Settings settings_;
+		std::vector<std::vector<double>> partials;  // one histogram per thread
+		std::vector<double> totals;
+		uint64_t steps_ = 0;
+	};
+}
+
+#endif
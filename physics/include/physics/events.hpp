@@ -0,0 +1,247 @@
+#ifndef __EVENTS_HPP__
+#define __EVENTS_HPP__
+
+#include "vec2.hpp"
+#include "balls.hpp"
+#include "ring_buffer.hpp"
+#include <cstdint>  // uint64_t
+#include <cstdio>  // std::FILE
+#include <string>  // std::string
+#include <vector>  // std::vector
+#include <memory>  // std::shared_ptr, std::unique_ptr
+#include <functional>  // std::function
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <span>  // std::span
+
+// Collision event recording
+// Each thread stepping the World writes the bounces it resolves into its own lock-free ring buffer,
+// a single consumer thread drains the rings and hands the records to a Sink in batches
+
+namespace Events {
+	struct Bounce {
+		uint64_t ball;  // index of the ball in the World
+		double time;  // simulation time at which the bounce happened
+		uint64_t curve;  // index of the curve in the World
+		double t;  // parameter of the bounce point on the curve
+		vec2 pos;  // bounce point
+		vec2 vel;  // outgoing velocity
+	};
+
+	// What a producer does when its ring buffer is full
+	enum class Overflow {
+		BLOCK,  // wait for the consumer (back-pressure on the simulation)
+		DROP  // discard the record and count it
+	};
+
+	struct Settings {
+		size_t capacity = 1 << 14;  // records per producer ring buffer
+		Overflow overflow = Overflow::BLOCK;
+		size_t batch = 1 << 10;  // maximum number of records handed to the sink at once
+		bool flush_every_step = false;  // World::step hands the records of the step to the sink, and flushes it, before returning
+	};
+
+	// Receives bounce records, always from a single thread at a time
+	class Sink {
+	public:
+		virtual ~Sink() = default;
+		virtual void consume(Bounce const* bounces, size_t n) = 0;
+		virtual void flush() {}
+	};
+
+	// Appends the raw records to a binary file (64 bytes per record, native endianness, same layout as Bounce)
+	// A failed write is latched: records are then missing from the file, which failed() and close() report
+	class FileSink : public Sink {
+		std::string filepath;
+		mutable std::mutex mutex;  // close() may be called while the consumer thread writes
+		std::FILE* file;
+		bool failed_ = false;
+	public:
+		explicit FileSink(std::string const& filepath);
+		// closes the file, errors are only reported by an explicit close()
+		virtual ~FileSink();
+		FileSink(FileSink const&) = delete;
+		FileSink& operator=(FileSink const&) = delete;
+
+		virtual void consume(Bounce const* bounces, size_t n) override;
+		virtual void flush() override;
+		// true once a write failed, or records reached the sink after close()
+		bool failed() const;
+		// closes the file, throws std::runtime_error if any record could not be written
+		void close();
+	};
+
+	// Event log: the state of the balls when recording starts, followed by every bounce
+	// Between bounces balls move in straight lines, so the log determines the whole trajectory (see Reconstructor)
+	//
+	// Layout (native endianness):
+	//   LogHeader              64 bytes
+	//   vec2 pos[nballs]       initial positions
+	//   vec2 vel[nballs]       initial velocities
+	//   Bounce[]               until the end of the file, same records as FileSink
+	constexpr char LOG_MAGIC[8] = {'C', 'B', 'E', 'V', 'L', 'O', 'G', '\0'};
+	constexpr uint32_t LOG_VERSION = 1;
+	constexpr uint32_t LOG_BYTE_ORDER_MARK = 0x01020304;
+
+	struct LogHeader {
+		char magic[8];
+		uint32_t version;
+		uint32_t byte_order;
+		uint64_t nballs;
+		double time;  // simulation time of the initial state
+		uint64_t reserved[4];
+	};
+
+	// Writes an event log, starting from `time` and `balls`, which must be the current state of the World it records
+	// Balls added to the World afterwards cannot be reconstructed
+	// Write errors are latched as in FileSink, a truncated log would otherwise be read back as a valid one
+	class LogSink : public Sink {
+		std::string filepath;
+		mutable std::mutex mutex;  // close() may be called while the consumer thread writes
+		std::FILE* file;
+		bool failed_ = false;
+	public:
+		LogSink(std::string const& filepath, double time, Balls const& balls);
+		// closes the file, errors are only reported by an explicit close()
+		virtual ~LogSink();
+		LogSink(LogSink const&) = delete;
+		LogSink& operator=(LogSink const&) = delete;
+
+		virtual void consume(Bounce const* bounces, size_t n) override;
+		virtual void flush() override;
+		// true once a write failed, or records reached the sink after close()
+		bool failed() const;
+		// closes the file, throws std::runtime_error if any record could not be written
+		void close();
+	};
+
+	// Reads an event log and gives the exact position of any ball at any time after the start of the log
+	// The bounces of every ball are sorted by time, a position is found by binary search over them
+	class Reconstructor {
+	public:
+		explicit Reconstructor(std::string const& filepath);
+
+		size_t nballs() const { return pos0.size(); }
+		double start_time() const { return time0; }
+		size_t nbounces() const { return bounces_.size(); }
+		// bounces of `ball`, sorted by time
+		std::span<Bounce const> bounces(size_t ball) const {
+			return std::span<Bounce const>(bounces_.data() + first[ball], first[ball+1] - first[ball]);
+		}
+
+		vec2 position(size_t ball, double time) const;
+		vec2 velocity(size_t ball, double time) const;
+		// positions of all the balls at `time`
+		void positions(double time, vec2* out) const;
+
+	private:
+		double time0;
+		std::vector<vec2> pos0, vel0;
+		std::vector<Bounce> bounces_;  // grouped by ball
+		std::vector<size_t> first;  // bounces of ball i are [first[i], first[i+1])
+
+		// last bounce of `ball` at or before `time`, null if there is none
+		Bounce const* last_bounce(size_t ball, double time) const;
+	};
+
+	// Accumulates records and calls `callback` with batches of (at most) `batch_size` records
+	class CallbackSink : public Sink {
+	public:
+		typedef std::function<void(std::vector<Bounce> const&)> Callback;
+
+		CallbackSink(Callback callback, size_t batch_size = 1 << 12);
+
+		virtual void consume(Bounce const* bounces, size_t n) override;
+		virtual void flush() override;
+
+	private:
+		Callback callback;
+		size_t batch_size;
+		std::vector<Bounce> batch;
+	};
+
+	// Counts hits per curve, binned over the curve parameter t in [0, 1]
+	class HistogramSink : public Sink {
+	public:
+		explicit HistogramSink(size_t nbins = 100);
+
+		virtual void consume(Bounce const* bounces, size_t n) override;
+
+		size_t nbins() const { return nbins_; }
+		size_t ncurves() const;
+		// hits on `curve` with parameter in bin `bin`
+		uint64_t count(size_t curve, size_t bin) const;
+		// hits on `curve`, all parameters
+		uint64_t count(size_t curve) const;
+		// row-major (ncurves, nbins) copy of the histogram
+		std::vector<uint64_t> counts() const;
+
+	private:
+		size_t nbins_;
+		std::vector<uint64_t> bins;
+		mutable std::mutex mutex;  // consume() runs on the consumer thread, the getters on any thread
+	};
+
+	class EventQueue {
+	public:
+		EventQueue(std::shared_ptr<Sink> sink, unsigned int nproducers = 1, Settings const& settings = Settings());
+		// drains all pending records into the sink before returning
+		~EventQueue();
+
+		EventQueue(EventQueue const&) = delete;
+		EventQueue& operator=(EventQueue const&) = delete;
+
+		// must only be called by one thread per producer index
+		void push(unsigned int producer, Bounce const& bounce) {
+			Producer& p(*producers_[producer]);
+			if (p.ring.push(bounce)) {
+				p.pushed.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+			if (settings_.overflow == Overflow::DROP) {
+				p.dropped.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+			while (!p.ring.push(bounce))
+				std::this_thread::yield();
+			p.pushed.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		// blocks until every record pushed so far has been consumed, then flushes the sink
+		// producers must not push concurrently
+		void flush();
+
+		unsigned int producers() const { return producers_.size(); }
+		Settings const& settings() const { return settings_; }
+		std::shared_ptr<Sink> const& sink() const { return sink_; }
+
+		uint64_t pushed() const;
+		uint64_t dropped() const;
+		uint64_t dropped(unsigned int producer) const { return producers_[producer]->dropped.load(std::memory_order_relaxed); }
+		uint64_t consumed() const { return consumed_.load(std::memory_order_acquire); }
+
+	private:
+		struct Producer {
+			RingBuffer<Bounce> ring;
+			alignas(64) std::atomic<uint64_t> pushed;
+			std::atomic<uint64_t> dropped;
+			explicit Producer(size_t capacity) : ring(capacity), pushed(0), dropped(0) {}
+		};
+
+		std::shared_ptr<Sink> sink_;
+		Settings settings_;
+		std::vector<std::unique_ptr<Producer>> producers_;
+		std::atomic<uint64_t> consumed_;
+		std::atomic<bool> running;
+		std::mutex sink_mutex;
+		std::thread consumer;
+
+		// consumer thread main loop
+		void consume();
+		// moves one batch of every ring to the sink, returns the number of records moved
+		size_t drain(std::vector<Bounce>& buffer);
+	};
+}
+
+#endif
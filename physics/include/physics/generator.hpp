@@ -0,0 +1,139 @@
+#ifndef __GENERATOR_HPP__
+#define __GENERATOR_HPP__
+
+#include <coroutine>
+#include <exception>  // std::exception_ptr
+#include <iterator>  // std::default_sentinel_t
+#include <memory>  // std::addressof
+#include <ranges>  // std::ranges::view_interface
+#include <stdexcept>  // std::invalid_argument
+#include <utility>  // std::exchange, std::move
+#include <cstddef>  // size_t, ptrdiff_t
+
+// Lazy, move-only C++20 coroutine generator
+// The coroutine only runs when the consumer pulls the next element, and is destroyed
+// (without running any further) when the consumer stops iterating.
+// Elements are yielded by reference and are only valid until the next element is pulled.
+// Generator models std::ranges::input_range, so it composes with std::views::filter, std::views::take, ...
+
+template <typename T>
+class Generator : public std::ranges::view_interface<Generator<T>> {
+public:
+	struct promise_type {
+		T const* current = nullptr;
+		std::exception_ptr error;
+
+		Generator get_return_object() { return Generator(std::coroutine_handle<promise_type>::from_promise(*this)); }
+		std::suspend_always initial_suspend() noexcept { return {}; }
+		std::suspend_always final_suspend() noexcept { return {}; }
+		// a yielded temporary lives until the coroutine is resumed, so pointing to it is safe
+		std::suspend_always yield_value(T const& value) noexcept {
+			current = std::addressof(value);
+			return {};
+		}
+		void return_void() noexcept {}
+		void unhandled_exception() { error = std::current_exception(); }
+		// co_await is not supported inside generators
+		template <typename U>
+		std::suspend_never await_transform(U&&) = delete;
+	};
+
+	class iterator {
+		std::coroutine_handle<promise_type> handle;
+	public:
+		using value_type = T;
+		using difference_type = ptrdiff_t;
+
+		iterator() = default;
+		explicit iterator(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+
+		T const& operator*() const { return *handle.promise().current; }
+		T const* operator->() const { return handle.promise().current; }
+
+		iterator& operator++() {
+			handle.resume();
+			if (handle.done() && handle.promise().error)
+				std::rethrow_exception(handle.promise().error);
+			return *this;
+		}
+		void operator++(int) { ++*this; }
+
+		friend bool operator==(iterator const& it, std::default_sentinel_t) { return !it.handle || it.handle.done(); }
+	};
+
+	Generator() = default;
+	Generator(Generator&& other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+	Generator& operator=(Generator&& other) noexcept {
+		if (this != &other) {
+			if (handle) handle.destroy();
+			handle = std::exchange(other.handle, nullptr);
+		}
+		return *this;
+	}
+	Generator(Generator const&) = delete;
+	Generator& operator=(Generator const&) = delete;
+	~Generator() { if (handle) handle.destroy(); }
+
+	// runs the coroutine up to the first element, may only be called once
+	iterator begin() {
+		if (handle) {
+			handle.resume();
+			if (handle.done() && handle.promise().error)
+				std::rethrow_exception(handle.promise().error);
+		}
+		return iterator(handle);
+	}
+	std::default_sentinel_t end() const { return {}; }
+
+private:
+	std::coroutine_handle<promise_type> handle = nullptr;
+
+	explicit Generator(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+};
+
+// Generator adaptors that the standard library does not provide in C++20
+namespace Generators {
+	namespace detail {
+		template <typename T>
+		Generator<T> decimate(Generator<T> gen, size_t every) {
+			size_t i(0);
+			for (T const& value : gen)
+				if (i++ % every == 0)
+					co_yield value;
+		}
+	}
+
+	// yields every `every`-th element, starting with the first one
+	// throws std::invalid_argument if `every` is 0 (when called, not when the first element is pulled)
+	template <typename T>
+	Generator<T> decimate(Generator<T> gen, size_t every) {
+		if (every == 0)
+			throw std::invalid_argument("cannot decimate by 0");
+		return detail::decimate(std::move(gen), every);
+	}
+
+	// yields the first `n` elements, without pulling the element after the last one
+	template <typename T>
+	Generator<T> take(Generator<T> gen, size_t n) {
+		if (n == 0)
+			co_return;
+		size_t i(0);
+		for (T const& value : gen) {
+			co_yield value;
+			if (++i == n)
+				break;
+		}
+	}
+
+	// yields elements while `pred(element)` holds, the first element failing the predicate is not yielded
+	template <typename T, typename Pred>
+	Generator<T> take_while(Generator<T> gen, Pred pred) {
+		for (T const& value : gen) {
+			if (!pred(value))
+				break;
+			co_yield value;
+		}
+	}
+}
+
+#endif
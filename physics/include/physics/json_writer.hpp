@@ -0,0 +1,101 @@
+#ifndef __JSON_WRITER_HPP__
+#define __JSON_WRITER_HPP__
+
+#include "vec2.hpp"
+#include <charconv>  // std::to_chars
+#include <cstring>  // std::memcpy
+#include <cstdint>  // uint64_t
+#include <memory>  // std::unique_ptr
+#include <string>  // std::string
+#include <string_view>  // std::string_view
+
+// Buffered JSON output, streamed to a file descriptor or appended to a string
+// Doubles are written with std::to_chars (shortest representation that parses back to the same value),
+// and nothing is allocated per value: the writer only owns a fixed buffer, flushed when full.
+
+class JsonWriter {
+	static constexpr size_t MAX_NUMBER_CHARS = 32;  // longest std::to_chars output for a double is 24
+
+	int fd = -1;
+	bool owns_fd = false;
+	std::string* target = nullptr;
+	std::unique_ptr<char[]> buffer;
+	size_t capacity;
+	size_t used = 0;
+
+	void reserve(size_t n) {
+		if (used + n > capacity)
+			flush_buffer();
+	}
+	void write_out(char const* data, size_t n);
+	void flush_buffer() {
+		write_out(buffer.get(), used);
+		used = 0;
+	}
+
+public:
+	// writes to (and closes) the file at `filepath`, truncated
+	explicit JsonWriter(std::string const& filepath, size_t capacity = 1 << 20);
+	// writes to an already open file descriptor (stdout, pipes, ...), left open
+	explicit JsonWriter(int fd, size_t capacity = 1 << 20);
+	// appends to `target`
+	explicit JsonWriter(std::string* target, size_t capacity = 1 << 16);
+	// flushes, errors are only reported by an explicit flush()
+	~JsonWriter();
+	JsonWriter(JsonWriter const&) = delete;
+	JsonWriter& operator=(JsonWriter const&) = delete;
+
+	// writes the buffered output, throws std::runtime_error if the file descriptor cannot be written
+	void flush();
+
+	JsonWriter& raw(char c) {
+		reserve(1);
+		buffer[used++] = c;
+		return *this;
+	}
+
+	JsonWriter& raw(std::string_view str) {
+		if (str.size() > capacity) {
+			// too large to be buffered
+			flush_buffer();
+			write_out(str.data(), str.size());
+			return *this;
+		}
+		reserve(str.size());
+		std::memcpy(buffer.get() + used, str.data(), str.size());
+		used += str.size();
+		return *this;
+	}
+
+	JsonWriter& number(double x) {
+		reserve(MAX_NUMBER_CHARS);
+		used = std::to_chars(buffer.get() + used, buffer.get() + capacity, x).ptr - buffer.get();
+		return *this;
+	}
+
+	JsonWriter& integer(uint64_t x) {
+		reserve(MAX_NUMBER_CHARS);
+		used = std::to_chars(buffer.get() + used, buffer.get() + capacity, x).ptr - buffer.get();
+		return *this;
+	}
+
+	// same schema as vec2::json
+	JsonWriter& vec(vec2 const& v) {
+		raw("{\"class\":\"vec2\",\"parameters\":{\"x\":");
+		number(v.x);
+		raw(",\"y\":");
+		number(v.y);
+		return raw("}}");
+	}
+
+	// same schema as Ball::json
+	JsonWriter& ball(vec2 const& pos, vec2 const& vel) {
+		raw("{\"class\":\"Ball\",\"parameters\":{\"pos\":");
+		vec(pos);
+		raw(",\"vel\":");
+		vec(vel);
+		return raw("}}");
+	}
+};
+
+#endif
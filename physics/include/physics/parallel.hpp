@@ -0,0 +1,139 @@
+#ifndef __PARALLEL_HPP__
+#define __PARALLEL_HPP__
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+#include <algorithm>  // std::min, std::find
+#include <exception>  // std::exception_ptr
+#include <memory>  // std::addressof
+#include <type_traits>  // std::remove_reference_t
+#include <cstddef>  // size_t
+
+namespace Parallel {
+	// number of threads the hardware can run concurrently (at least 1)
+	inline unsigned int hardware_threads() {
+		unsigned int n(std::thread::hardware_concurrency());
+		return n == 0 ? 1 : n;
+	}
+
+	// first index of chunk `i` when splitting [0, n) into `nchunks` contiguous chunks
+	// chunk boundaries only depend on n and nchunks, so per-chunk results can be merged deterministically
+	inline size_t chunk_begin(size_t n, unsigned int nchunks, unsigned int i) {
+		return n / nchunks * i + std::min<size_t>(i, n % nchunks);
+	}
+
+	// a for_chunks call in progress, whose chunks are claimed in order by the pool workers and the caller
+	struct Job {
+		void (*call)(void* fn, unsigned int chunk, size_t begin, size_t end);
+		void* fn;
+		size_t n;
+		unsigned int nchunks;
+		std::vector<std::exception_ptr> errors;
+		// guarded by the pool mutex
+		unsigned int next = 0;
+		unsigned int done = 0;
+	};
+
+	// Worker threads started once and reused by every for_chunks call
+	// The caller claims chunks of its own job too, so nested calls and calls from several threads cannot
+	// starve each other, and a job still completes when all the workers are busy (or lost across a fork)
+	class Pool {
+	private:
+		std::mutex mutex;
+		std::condition_variable wake;  // a job was queued, or the pool is stopping
+		std::condition_variable finished;  // a chunk completed
+		std::deque<Job*> jobs;  // jobs with unclaimed chunks
+		bool stopping = false;
+		std::vector<std::thread> workers;
+
+		// claims the next chunk of `job`, the mutex must be held and a chunk must be left
+		unsigned int claim(Job& job) {
+			unsigned int chunk(job.next++);
+			if (job.next == job.nchunks)
+				jobs.erase(std::find(jobs.begin(), jobs.end(), &job));
+			return chunk;
+		}
+
+		// runs a claimed chunk with the mutex released, the job outlives it since it is not done yet
+		void execute(std::unique_lock<std::mutex>& lock, Job& job, unsigned int chunk) {
+			lock.unlock();
+			try { job.call(job.fn, chunk, chunk_begin(job.n, job.nchunks, chunk), chunk_begin(job.n, job.nchunks, chunk+1)); }
+			catch (...) { job.errors[chunk] = std::current_exception(); }
+			lock.lock();
+			if (++job.done == job.nchunks)
+				finished.notify_all();
+		}
+
+		void work() {
+			std::unique_lock<std::mutex> lock(mutex);
+			while (true) {
+				wake.wait(lock, [&]() { return stopping || !jobs.empty(); });
+				if (stopping)
+					return;
+				Job& job(*jobs.front());
+				execute(lock, job, claim(job));
+			}
+		}
+
+	public:
+		explicit Pool(unsigned int nworkers) {
+			workers.reserve(nworkers);
+			for (unsigned int i(0); i < nworkers; ++i)
+				workers.emplace_back([this]() { work(); });
+		}
+		Pool(Pool const&) = delete;
+		Pool& operator=(Pool const&) = delete;
+		~Pool() {
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				stopping = true;
+			}
+			wake.notify_all();
+			for (std::thread& worker : workers)
+				worker.join();
+		}
+
+		// pool shared by the whole process, the calling thread is the last hardware thread
+		static Pool& shared() {
+			static Pool pool(hardware_threads() - 1);
+			return pool;
+		}
+
+		// runs every chunk of `job` and returns once they are all done
+		void run(Job& job) {
+			std::unique_lock<std::mutex> lock(mutex);
+			jobs.push_back(&job);
+			for (unsigned int i(1); i < job.nchunks; ++i)
+				wake.notify_one();
+			while (job.next < job.nchunks)
+				execute(lock, job, claim(job));
+			finished.wait(lock, [&]() { return job.done == job.nchunks; });
+		}
+	};
+
+	// calls fn(chunk, begin, end) for each chunk of [0, n), the chunks run concurrently on the shared pool
+	// at most n chunks are made (one when n is 0), exceptions thrown by fn are rethrown on the calling thread
+	template <typename Fn>
+	void for_chunks(size_t n, unsigned int nchunks, Fn&& fn) {
+		nchunks = std::min<size_t>(nchunks, std::max<size_t>(n, 1));
+		if (nchunks <= 1) {
+			fn(0u, size_t(0), n);
+			return;
+		}
+
+		typedef std::remove_reference_t<Fn> F;
+		Job job{
+			[](void* f, unsigned int chunk, size_t begin, size_t end) { (*static_cast<F*>(f))(chunk, begin, end); },
+			const_cast<void*>(static_cast<void const*>(std::addressof(fn))), n, nchunks,
+			std::vector<std::exception_ptr>(nchunks)
+		};
+		Pool::shared().run(job);
+		for (std::exception_ptr const& error : job.errors)
+			if (error) std::rethrow_exception(error);
+	}
+}
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef __RING_BUFFER_HPP__
+#define __RING_BUFFER_HPP__
+
+#include <atomic>
+#include <memory>  // std::unique_ptr
+#include <utility>  // std::move
+#include <cstddef>  // size_t
+
+// Bounded single-producer single-consumer lock-free queue
+// Exactly one thread may call push(), and exactly one (other) thread may call pop()
+// The capacity is rounded up to a power of two so that indices can be masked instead of wrapped
+
+template <typename T>
+class RingBuffer {
+	// keep the producer and consumer indices on separate cache lines to avoid false sharing
+	static constexpr size_t CACHE_LINE = 64;
+
+	size_t mask;
+	std::unique_ptr<T[]> slots;
+	alignas(CACHE_LINE) std::atomic<size_t> head;  // next slot to be written (owned by the producer)
+	alignas(CACHE_LINE) std::atomic<size_t> tail;  // next slot to be read (owned by the consumer)
+
+	static size_t round_up_pow2(size_t n) {
+		size_t p(1);
+		while (p < n) p <<= 1;
+		return p;
+	}
+
+public:
+	explicit RingBuffer(size_t capacity)
+		: mask(round_up_pow2(capacity < 2 ? 2 : capacity) - 1),
+		slots(new T[mask + 1]),
+		head(0), tail(0) {}
+
+	RingBuffer(RingBuffer const&) = delete;
+	RingBuffer& operator=(RingBuffer const&) = delete;
+
+	size_t capacity() const { return mask + 1; }
+
+	// approximate when called from a thread other than the producer or consumer
+	size_t size() const {
+		return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+	}
+
+	bool empty() const { return size() == 0; }
+
+	// producer side, returns false if the buffer is full
+	bool push(T const& item) {
+		size_t h(head.load(std::memory_order_relaxed));
+		if (h - tail.load(std::memory_order_acquire) > mask)
+			return false;
+		slots[h & mask] = item;
+		head.store(h + 1, std::memory_order_release);
+		return true;
+	}
+	bool push(T&& item) {
+		size_t h(head.load(std::memory_order_relaxed));
+		if (h - tail.load(std::memory_order_acquire) > mask)
+			return false;
+		slots[h & mask] = std::move(item);
+		head.store(h + 1, std::memory_order_release);
+		return true;
+	}
+
+	// consumer side, returns false if the buffer is empty
+	bool pop(T& item) {
+		size_t t(tail.load(std::memory_order_relaxed));
+		if (t == head.load(std::memory_order_acquire))
+			return false;
+		item = std::move(slots[t & mask]);
+		tail.store(t + 1, std::memory_order_release);
+		return true;
+	}
+
+	// consumer side, pops up to `max` items into `out` and returns how many were popped
+	size_t pop_bulk(T* out, size_t max) {
+		size_t t(tail.load(std::memory_order_relaxed));
+		size_t n(head.load(std::memory_order_acquire) - t);
+		if (n > max) n = max;
+		for (size_t i(0); i < n; ++i)
+			out[i] = slots[(t + i) & mask];
+		tail.store(t + n, std::memory_order_release);
+		return n;
+	}
+};
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef __STATISTICS_HPP__
+#define __STATISTICS_HPP__
+
+#include "vec2.hpp"
+#include <cstdint>  // uint64_t
+#include <vector>  // std::vector
+#include <algorithm>  // std::min
+
+// Streaming per-step statistics
+// Each thread stepping the World updates its own accumulator, without any shared atomics.
+// The accumulators are merged into the totals, in thread order, every `merge_every` steps,
+// so the totals do not depend on the scheduling of the threads
+
+namespace Statistics {
+	struct Settings {
+		unsigned int merge_every = 1;  // number of steps between two merges
+		double speed_tolerance = 1e-9;  // relative speed drift above which a sample counts as a violation
+		// spatial occupancy histogram over [grid_min, grid_max], disabled when nx or ny is 0
+		vec2 grid_min, grid_max;
+		size_t nx = 0, ny = 0;
+	};
+
+	struct alignas(64) Accumulator {
+		uint64_t samples = 0;
+		uint64_t collisions = 0;
+		uint64_t drift_violations = 0;
+		double max_speed_drift = 0;
+		std::vector<uint64_t> curve_hits;
+		std::vector<uint64_t> occupancy;  // row-major (ny, nx)
+
+		void clear();
+	};
+
+	class Collector {
+	public:
+		explicit Collector(Settings const& settings = Settings());
+
+		Settings const& settings() const { return settings_; }
+
+		// called by the World before stepping, with the reference speeds of the balls added since the last call
+		void prepare(unsigned int nthreads, size_t ncurves);
+		void add_reference_speed(double speed) { speed0.push_back(speed); }
+		size_t nreferences() const { return speed0.size(); }
+		// forgets the reference speeds of the balls from index `first` on (balls replaced or removed),
+		// the next step takes their current speeds instead
+		void reset_references(size_t first = 0) { speed0.resize(std::min(first, speed0.size())); }
+		// the reference speed of `ball` becomes `speed` (ball replaced), if it has one already
+		void set_reference_speed(size_t ball, double speed) {
+			if (ball < speed0.size())
+				speed0[ball] = speed;
+		}
+
+		// called concurrently by the stepping threads, each with its own `thread` index
+		void bounce(unsigned int thread, size_t curve) {
+			Accumulator& acc(accumulators[thread]);
+			++acc.collisions;
+			++acc.curve_hits[curve];
+		}
+		void sample(unsigned int thread, size_t ball, vec2 const& pos, vec2 const& vel);
+
+		// called by the World after stepping, merges every `merge_every` steps
+		void end_step();
+		// folds the per-thread accumulators into the totals
+		void merge();
+		// clears the totals and accumulators, the next steps measure drift against the current speeds
+		void reset();
+
+		// merged totals (up to the last merge)
+		uint64_t steps() const { return steps_; }
+		uint64_t samples() const { return totals.samples; }
+		uint64_t collisions() const { return totals.collisions; }
+		uint64_t drift_violations() const { return totals.drift_violations; }
+		double max_speed_drift() const { return totals.max_speed_drift; }
+		std::vector<uint64_t> const& curve_hits() const { return totals.curve_hits; }
+		std::vector<uint64_t> const& occupancy() const { return totals.occupancy; }
+
+	private:
+		Settings settings_;
+		std::vector<Accumulator> accumulators;
+		Accumulator totals;
+		std::vector<double> speed0;  // reference speed of every ball
+		uint64_t steps_ = 0;
+		uint64_t unmerged_steps = 0;
+	};
+}
+
+#endif
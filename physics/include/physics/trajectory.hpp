@@ -0,0 +1,133 @@
+#ifndef __TRAJECTORY_HPP__
+#define __TRAJECTORY_HPP__
+
+#include "vec2.hpp"
+#include "balls.hpp"
+#include <cstdint>  // uint32_t, uint64_t
+#include <cstddef>  // size_t
+#include <cstdio>  // std::FILE
+#include <string>  // std::string
+#include <vector>  // std::vector
+
+// Compressed trajectory files
+// Frames (time, positions and velocities of all the balls) are recorded every `every` steps and grouped into
+// chunks of `chunk_frames` frames. Inside a chunk, every value is predicted by linear extrapolation of the
+// same quantity in the two previous frames, and the XOR of the value and its prediction is bit-packed
+// Gorilla-style (a few bits when nothing changed, only the meaningful bits otherwise). The compression is
+// lossless, and every chunk is self-contained, so any range of frames is decoded from its chunks only.
+//
+// Layout (native endianness, offsets from the start of the file):
+//   Header                  64 bytes
+//   chunk data              bitstreams of 64-bit words, at the offsets listed in the index
+//   ChunkRecord[nchunks]    at index_offset, written when the recorder is closed
+//
+// Values of a chunk are stored frame by frame: time, then pos.x, pos.y, vel.x, vel.y of every ball
+
+namespace Trajectory {
+	constexpr char MAGIC[8] = {'C', 'B', 'T', 'R', 'A', 'J', '\0', '\0'};
+	constexpr uint32_t VERSION = 1;
+	constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+	struct Header {
+		char magic[8];
+		uint32_t version;
+		uint32_t byte_order;
+		uint64_t nballs;
+		uint64_t nframes;
+		uint64_t nchunks;
+		uint64_t index_offset;  // 0 while the file is being recorded
+		uint32_t every;
+		uint32_t chunk_frames;
+		uint64_t reserved;
+	};
+
+	struct ChunkRecord {
+		uint64_t first_frame;
+		uint64_t nframes;
+		uint64_t offset;
+		uint64_t bytes;  // multiple of 8
+	};
+
+	struct Settings {
+		unsigned int every = 1;  // number of steps between two recorded frames
+		unsigned int chunk_frames = 64;  // frames per chunk
+	};
+
+	// Encoder state of one recorded quantity
+	struct Stream {
+		double prev1 = 0, prev2 = 0;  // values in the two previous frames of the chunk
+		uint8_t lead = 64, trail = 0;  // bit window of the previous XOR (lead == 64: none yet)
+	};
+
+	class Recorder {
+	public:
+		Recorder(std::string const& filepath, Settings const& settings = Settings());
+		// closes the file, errors are only reported by an explicit close()
+		~Recorder();
+		Recorder(Recorder const&) = delete;
+		Recorder& operator=(Recorder const&) = delete;
+
+		Settings const& settings() const { return settings_; }
+
+		// called by the World after stepping, records a frame every `every` steps
+		void end_step(double time, Balls const& balls) {
+			if (++unrecorded_steps < settings_.every)
+				return;
+			unrecorded_steps = 0;
+			record(time, balls);
+		}
+		// records a frame now, all frames must have the same number of balls
+		void record(double time, Balls const& balls);
+		// writes the pending chunk and the index, throws std::runtime_error if the file cannot be written
+		void close();
+
+		uint64_t nframes() const { return nframes_; }
+		// bytes written so far (the pending chunk is not counted)
+		uint64_t bytes() const { return offset; }
+
+	private:
+		std::string filepath;
+		Settings settings_;
+		std::FILE* file;
+		Header header;
+		std::vector<ChunkRecord> index;
+		std::vector<Stream> streams;  // 1 + 4*nballs
+		std::vector<uint64_t> words;  // bitstream of the pending chunk
+		uint64_t acc = 0;  // bits not yet in `words`, most significant first
+		unsigned int nbits = 0;
+		uint64_t offset;  // end of the chunk data
+		uint64_t nframes_ = 0;
+		unsigned int chunk_nframes = 0;  // frames in the pending chunk
+		unsigned int unrecorded_steps = 0;
+
+		void write_bits(uint64_t value, unsigned int n);
+		void encode(Stream& stream, double value);
+		void flush_chunk();
+	};
+
+	class Reader {
+	public:
+		explicit Reader(std::string const& filepath);
+		~Reader();
+		Reader(Reader const&) = delete;
+		Reader& operator=(Reader const&) = delete;
+
+		size_t nballs() const { return header.nballs; }
+		size_t nframes() const { return header.nframes; }
+		unsigned int every() const { return header.every; }
+		std::vector<ChunkRecord> const& chunks() const { return index; }
+
+		// decodes frames [first, first + n) into `times` (n values), `pos` and `vel` (n*nballs values, frame-major)
+		// any of the outputs may be null, only the chunks holding the frames are read
+		// safe to call concurrently
+		void read(size_t first, size_t n, double* times, vec2* pos, vec2* vel) const;
+
+	private:
+		std::string filepath;
+		int fd;
+		Header header;
+		std::vector<ChunkRecord> index;
+	};
+}
+
+#endif
@@ -14,11 +14,8 @@ struct vec2 {
 	vec2(const vec2& v) = default;
 	vec2(vec2&& v) = default;
 
-	vec2& operator=(const vec2& v) {
-		x = v.x;
-		y = v.y;
-		return *this;
-	}
+	// defaulted so that vec2 stays trivially copyable (arrays of vec2 are copied and mapped as raw memory)
+	vec2& operator=(const vec2& v) = default;
 
 	bool operator==(const vec2& other) { return other.x == x && other.y == y; }
 	bool operator!=(const vec2& other) { return !(*this == other); }
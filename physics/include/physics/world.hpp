@@ -3,55 +3,82 @@
 
 #include "globals.h" // Globals::EPS
 #include "ball.hpp"
+#include "balls.hpp"
+#include "ball_generator.hpp"
 #include "curve.hpp"
 #include "collider.hpp"
 #include "logger.hpp"
+#include "events.hpp"
+#include "statistics.hpp"
+#include "trajectory.hpp"
+#include "density.hpp"
+#include "parallel.hpp"
+#include "generator.hpp"
+#include "json_writer.hpp"
 #include <vector>
 #include <unordered_set>
 #include <algorithm>  // std::min_element
 #include <string>  // std::string
-#include <sstream>  // std::stringstream
 #include <iostream>  // std::ostream
 #include <memory>  // std::shared_ptr
+#include <cstdint>  // SIZE_MAX
+#include <span>  // std::span
 
 class World {
-	typedef std::shared_ptr<Ball> BallPtr;
 	typedef std::shared_ptr<Curve> CurvePtr;
-	typedef std::vector<BallPtr> BallPtrs;
 	typedef std::vector<CurvePtr> CurvePtrs;
 
 	struct Inter {
 		double t;
+		double s;  // parameter on the trajectory
 		vec2 interpt;
+		size_t curve_idx;
 		CurvePtr curve_ptr;
 	};
 
-	void integrate(double dt) {
-		for (BallPtr const& ball_ptr : ball_ptrs) {
-			ball_ptr->pos_prev = ball_ptr->pos;
-			ball_ptr->pos += ball_ptr->vel * dt;
+	unsigned int nthreads = 1;
+	// shared between copies of the World, which must then not be stepped concurrently
+	std::shared_ptr<Events::EventQueue> event_queue;
+	std::shared_ptr<Statistics::Collector> statistics;
+	std::shared_ptr<Trajectory::Recorder> trajectory;
+	std::shared_ptr<Density::Accumulator> density;
+	// per-thread bounces of the current step, only filled while events() is stepping
+	std::vector<std::vector<Events::Bounce>> step_bounces;
+	bool collect_bounces = false;
+
+	void integrate(size_t begin, size_t end, double dt) {
+		for (size_t i(begin); i < end; ++i) {
+			balls.pos_prev[i] = balls.pos[i];
+			balls.pos[i] += balls.vel[i] * dt;
 		}
 	}
 
-	void resolve_collision(Ball& ball) {
+	// `thread` is the index of the thread resolving this ball, used to pick its event ring buffer
+	void resolve_collision(size_t ball_idx, double dt, unsigned int thread) {
+		vec2& pos(balls.pos[ball_idx]);
+		vec2& pos_prev(balls.pos_prev[ball_idx]);
+		vec2& vel(balls.vel[ball_idx]);
 		std::vector<Inter> inters;
 		unsigned int iter_num = 0;
+		// the ball travels from pos_prev (at traj_time) to pos (at time + dt) in a straight line
+		double traj_time(time);
 
 		while (iter_num++ < Globals::MAX_COLL_ITERS) {
 			inters.clear();
-			Segment traj(ball.pos_prev, ball.pos);
-			Segment dir(ball.pos, ball.pos + ball.vel);
+			Segment traj(pos_prev, pos);
+			Segment dir(pos, pos + vel);
 			// Logger::debug("=== iteration " + std::to_string(iter_num) + " ===");
 			// Logger::debug(traj.str());
 
-			for (CurvePtr const& curve_ptr : curve_ptrs) {
+			for (size_t curve_idx(0); curve_idx < curve_ptrs.size(); ++curve_idx) {
+				CurvePtr const& curve_ptr(curve_ptrs[curve_idx]);
 				Collider::ParamPairs tpairs(dir.collide(*curve_ptr));
 				for (Collider::ParamPair& tpair : tpairs) {
 					vec2 interpt((*curve_ptr)(tpair.t2));
 					tpair.t1 = traj.inverse(interpt);  // substitute with t on the trajectory
 					// Logger::debug("candidate " + tpair.str() + " collision at " + interpt.str() + " with " + curve_ptr->str());
 
-					// Test if the intersection point lies on Segment(ball.pos_prev, ball.pos)
+					// Test if the intersection point lies on Segment(pos_prev, pos)
 					if (!tpair.on_both())
 						continue;
 
@@ -59,15 +86,15 @@ class World {
 					// This happens when a ball lands perfectly on the line
 					// In that case, the pos_prev and pos are the same,
 					// making the line coefficients (and the determinant) zero of the intersection check in the next iteration
-					// FIX : using ball.vel to give the orientation of the trajectory, instead of the Segment(ball.pos_prev, ball.pos)
+					// FIX : using vel to give the orientation of the trajectory, instead of the Segment(pos_prev, pos)
 					// But the fix doesn't work because on the next physics iteration, pos_prev will be the colliding pos
 					// triggering collision handling again, and moving the point to the other side
 					// To fix this, say the ball trajectory is a segment that excludes pos_prev
-					if ((interpt - ball.pos_prev).length() < Globals::EPS)
+					if ((interpt - pos_prev).length() < Globals::EPS)
 						continue;
 
 					// Logger::debug("selected " + tpair.str() + " collision at " + interpt.str() + " with " + curve_ptr->str());
-					inters.push_back(Inter{tpair.t2, interpt, curve_ptr});
+					inters.push_back(Inter{tpair.t2, tpair.t1, interpt, curve_idx, curve_ptr});
 				}
 			}
 
@@ -78,9 +105,10 @@ class World {
 			// Compute distance of pos_prev to all intersection points
 			std::vector<double> dists(inters.size());
 			for (unsigned int i(0); i < inters.size(); ++i) {
-				dists[i] = (inters[i].interpt - ball.pos_prev).length();
+				dists[i] = (inters[i].interpt - pos_prev).length();
 			}
 			double mindist = *std::min_element(dists.begin(), dists.end());
+			double bounce_time(traj_time);
 
 			// Resolve the collisions with the curves
 			for (unsigned int i(0); i < inters.size(); ++i) {
@@ -92,48 +120,168 @@ class World {
 					continue;
 
 				// Compute the correction
-				vec2 diff = ball.pos - inters[i].interpt;
+				vec2 diff = pos - inters[i].interpt;
 				vec2 n = inters[i].curve_ptr->ortho(inters[i].t).normalize();
 				vec2 m = inters[i].curve_ptr->tangent(inters[i].t).normalize();
 				vec2 newpos = inters[i].interpt - vec2::dot(n, diff)*n + vec2::dot(m, diff)*m;
-				vec2 newvel = -vec2::dot(n, ball.vel)*n + vec2::dot(m, ball.vel)*m;
+				vec2 newvel = -vec2::dot(n, vel)*n + vec2::dot(m, vel)*m;
+				bounce_time = Globals::lerp(traj_time, time + dt, inters[i].s);
 
 				// Resolve collision (with the closest line)
 				// Snap ball to intersection point. At this point the ball is on the same side as previously
-				ball.pos_prev = inters[i].interpt;
-				ball.pos = newpos;
-				ball.vel = newvel;
+				pos_prev = inters[i].interpt;
+				pos = newpos;
+				vel = newvel;
+
+				if (event_queue)
+					event_queue->push(thread, Events::Bounce{ball_idx, bounce_time, inters[i].curve_idx, inters[i].t, inters[i].interpt, newvel});
+				if (statistics)
+					statistics->bounce(thread, inters[i].curve_idx);
+				if (collect_bounces)
+					step_bounces[thread].push_back(Events::Bounce{ball_idx, bounce_time, inters[i].curve_idx, inters[i].t, inters[i].interpt, newvel});
 
 				// Next iteration resolves the rest of the collisions (ball may have crossed multiple lines in one step)
 			}
+			traj_time = bounce_time;
 		}
 	}
 
-	void resolve_collisions() {
-		for (BallPtr& ball_ptr : ball_ptrs)
-			resolve_collision(*ball_ptr);
+	void resolve_collisions(size_t begin, size_t end, double dt, unsigned int thread) {
+		for (size_t i(begin); i < end; ++i)
+			resolve_collision(i, dt, thread);
+	}
+
+	void sample_statistics(size_t begin, size_t end, unsigned int thread) {
+		for (size_t i(begin); i < end; ++i)
+			statistics->sample(thread, i, balls.pos[i], balls.vel[i]);
 	}
 
 public:
+	// Read-only view over the current ball positions, invalidated when balls are added
+	typedef std::span<vec2 const> Positions;
+
+	struct Frame {
+		size_t index;  // number of the frame, starting at 0
+		double time;  // simulation time of the frame
+		Positions positions;
+	};
+
 	// pybind11 needs to read these, so making public
-	BallPtrs ball_ptrs;
+	Balls balls;
 	CurvePtrs curve_ptrs;
+	// simulation time, advanced by step()
+	double time = 0;
 
 	World() = default;
 
 	void step(double dt) {
-		integrate(dt);
-		resolve_collisions();
+		if (statistics) {
+			statistics->prepare(nthreads, curve_ptrs.size());
+			// speed drift is measured against the speed a ball had when it was first seen,
+			// the references of removed balls must not be inherited by the balls added later at their index
+			statistics->reset_references(balls.size());
+			for (size_t i(statistics->nreferences()); i < balls.size(); ++i)
+				statistics->add_reference_speed(balls.vel[i].length());
+		}
+		if (density)
+			density->prepare(nthreads);
+
+		// balls are independent of each other, each thread integrates and resolves a contiguous chunk
+		Parallel::for_chunks(balls.size(), nthreads, [&](unsigned int thread, size_t begin, size_t end) {
+			integrate(begin, end, dt);
+			resolve_collisions(begin, end, dt, thread);
+			if (statistics)
+				sample_statistics(begin, end, thread);
+			if (density)
+				density->sample(thread, balls.pos.data() + begin, end - begin, dt);
+		});
+		time += dt;
+
+		if (statistics)
+			statistics->end_step();
+		if (trajectory)
+			trajectory->end_step(time, balls);
+		if (density)
+			density->end_step();
+		if (event_queue && event_queue->settings().flush_every_step)
+			event_queue->flush();
+	}
+
+	Positions positions() const { return Positions(balls.pos); }
+
+	// Lazily steps the World by `dt` and yields a view of the state after each step, at most `n` times
+	// The World is only stepped when the next frame is pulled, and must outlive the generator
+	Generator<Frame> frames(double dt, size_t n = SIZE_MAX) {
+		for (size_t i(0); i < n; ++i) {
+			step(dt);
+			co_yield Frame{i, time, positions()};
+		}
+	}
+
+	// Lazily steps the World by `dt` (at most `nsteps` times) and yields every bounce
+	// Bounces are resolved in parallel, so they are yielded after their step, in ball order
+	Generator<Events::Bounce> events(double dt, size_t nsteps = SIZE_MAX) {
+		for (size_t i(0); i < nsteps; ++i) {
+			step_bounces.resize(nthreads);
+			for (std::vector<Events::Bounce>& bounces : step_bounces)
+				bounces.clear();
+			collect_bounces = true;
+			try { step(dt); }
+			catch (...) { collect_bounces = false; throw; }
+			collect_bounces = false;
+			for (std::vector<Events::Bounce> const& bounces : step_bounces)
+				for (Events::Bounce const& bounce : bounces)
+					co_yield bounce;
+		}
+	}
+
+	unsigned int get_nthreads() const { return nthreads; }
+	void set_nthreads(unsigned int n) {
+		nthreads = n == 0 ? Parallel::hardware_threads() : n;
+		// every stepping thread needs its own ring buffer
+		if (event_queue && event_queue->producers() < nthreads) {
+			std::shared_ptr<Events::Sink> sink(event_queue->sink());
+			Events::Settings settings(event_queue->settings());
+			event_queue.reset();  // drain into the sink before a new consumer starts feeding it
+			event_queue = std::make_shared<Events::EventQueue>(sink, nthreads, settings);
+		}
 	}
 
-	void add_ball(BallPtr ball_ptr) { ball_ptrs.push_back(ball_ptr); }
+	// record every bounce into `sink` (nullptr stops recording, after draining pending records)
+	void set_event_sink(std::shared_ptr<Events::Sink> sink, Events::Settings const& settings = Events::Settings()) {
+		event_queue.reset();
+		if (sink)
+			event_queue = std::make_shared<Events::EventQueue>(sink, nthreads, settings);
+	}
+	std::shared_ptr<Events::EventQueue> const& get_event_queue() const { return event_queue; }
+
+	// accumulate statistics while stepping (nullptr disables them)
+	void set_statistics(std::shared_ptr<Statistics::Collector> collector) { statistics = collector; }
+	std::shared_ptr<Statistics::Collector> const& get_statistics() const { return statistics; }
+	// blocks until all bounces recorded so far have reached the sink
+	void flush_events() {
+		if (event_queue)
+			event_queue->flush();
+	}
+
+	// record frames into a compressed trajectory file while stepping (nullptr stops recording, the recorder stays open)
+	void set_trajectory(std::shared_ptr<Trajectory::Recorder> recorder) { trajectory = recorder; }
+	std::shared_ptr<Trajectory::Recorder> const& get_trajectory() const { return trajectory; }
+
+	// bin the ball positions into a density histogram after every step (nullptr stops binning)
+	void set_density(std::shared_ptr<Density::Accumulator> accumulator) { density = accumulator; }
+	std::shared_ptr<Density::Accumulator> const& get_density() const { return density; }
+
+	void add_ball(Ball const& ball) { balls.push_back(ball); }
+	// appends all the balls of the generator
+	void add_balls(BallGenerator const& generator) { generator.append(balls); }
 	void add_curve(CurvePtr curve_ptr) { curve_ptrs.push_back(curve_ptr); }
 
 	virtual std::string str() const {
 		std::string ret;
 		ret += "Balls:";
-		for (BallPtr const& ball_ptr : ball_ptrs) {
-			ret += "\n\t" + ball_ptr->str();
+		for (size_t i(0); i < balls.size(); ++i) {
+			ret += "\n\t" + balls.get(i).str();
 		}
 		ret += "\nCurves:";
 		for (CurvePtr const& curve_ptr : curve_ptrs) {
@@ -142,22 +290,44 @@ public:
 		return ret;
 	}
 
+	// streams the "balls" and "curves" members of the World JSON object, without the braces,
+	// so that other sections can be appended (see export_world_json)
+	void write_json_sections(JsonWriter& out) const {
+		out.raw("\"balls\":[");
+		for (size_t i(0); i < balls.size(); ++i) {
+			if (i > 0)
+				out.raw(',');
+			out.ball(balls.pos[i], balls.vel[i]);
+		}
+		out.raw("],\"curves\":[");
+		for (size_t i(0); i < curve_ptrs.size(); ++i) {
+			if (i > 0)
+				out.raw(',');
+			out.raw(curve_ptrs[i]->json());
+		}
+		out.raw(']');
+	}
+
+	// streams the World as JSON, curves are written through their (possibly overridden) json()
+	void write_json(JsonWriter& out) const {
+		out.raw('{');
+		write_json_sections(out);
+		out.raw('}');
+	}
+
+	void write_json(std::string const& filepath) const {
+		JsonWriter out(filepath);
+		write_json(out);
+		out.raw('\n');
+		out.flush();
+	}
+
 	std::string json() const {
-		std::stringstream ss;
-		ss
-			<< "{"
-				<< "\"balls\":[";
-					for (BallPtr const& ball_ptr : ball_ptrs)
-						ss << ball_ptr->json() << ",";
-					ss.seekp(-1, ss.cur);  // override the last comma
-				ss << "]" << ","
-				<< "\"curves\":[";
-					for (CurvePtr const& curve_ptr : curve_ptrs)
-						ss << curve_ptr->json() << ",";
-					ss.seekp(-1, ss.cur);  // override the last comma
-				ss << "]"
-			<< "}";
-		return ss.str();
+		std::string ret;
+		JsonWriter out(&ret);
+		write_json(out);
+		out.flush();
+		return ret;
 	}
 };
 
@@ -0,0 +1,78 @@
+#ifndef __WORLDFILE_HPP__
+#define __WORLDFILE_HPP__
+
+#include "world.hpp"
+#include <cstdint>  // uint32_t, uint64_t
+#include <cstddef>  // size_t
+#include <string>  // std::string
+
+// Binary world files
+// The balls are stored as columns laid out exactly like the Balls columns in memory, so a loaded file is
+// memory-mapped and the World steps directly on the mapped pages (privately, the file is never modified).
+//
+// Layout (native endianness, offsets from the start of the file):
+//   Header                  64 bytes
+//   CurveRecord[ncurves]    at curves_offset
+//   vec2 pos[nballs]        at balls_offset, which is a multiple of ALIGNMENT
+//   vec2 pos_prev[nballs]   at balls_offset + column_bytes(nballs)
+//   vec2 vel[nballs]        at balls_offset + 2*column_bytes(nballs)
+
+namespace WorldFile {
+	constexpr char MAGIC[8] = {'C', 'B', 'W', 'O', 'R', 'L', 'D', '\0'};
+	constexpr uint32_t VERSION = 1;
+	constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;  // reads differently on a machine of the other endianness
+	constexpr size_t ALIGNMENT = 64;
+
+	enum class CurveKind : uint32_t {
+		LINE = 1,  // p, q, r
+		SEGMENT,  // p1.x, p1.y, p2.x, p2.y
+		ARC,  // p0.x, p0.y, r, theta_min, theta_max
+		ELLIPSE,  // p0.x, p0.y, a, b, phi, theta_min, theta_max
+		BEZIER_CUBIC  // p0.x, p0.y, p1.x, p1.y, p2.x, p2.y, p3.x, p3.y
+	};
+
+	struct Header {
+		char magic[8];
+		uint32_t version;
+		uint32_t byte_order;
+		uint64_t file_size;
+		uint64_t ncurves;
+		uint64_t nballs;
+		uint64_t curves_offset;
+		uint64_t balls_offset;
+		double time;  // simulation time of the World
+	};
+
+	struct CurveRecord {
+		uint32_t kind;  // CurveKind
+		uint32_t reserved;
+		double params[9];  // unused parameters are zero
+	};
+
+	// bytes taken by a column of `nballs` vec2, padded so the next column stays aligned
+	inline size_t column_bytes(size_t nballs) {
+		return (nballs * sizeof(vec2) + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+	}
+
+	// whether the file starts with the binary world file magic
+	bool is_world_file(std::string const& filepath);
+
+	// curves must be (or derive from) one of the built-in curve classes
+	void save(World const& world, std::string const& filepath);
+
+	// maps the file and lets the balls borrow the mapped columns, or copies them into owned storage if `map` is false
+	World load(std::string const& filepath, bool map = true);
+
+	// In-memory world files, for pickling and shared memory
+	// size of the world file of `world`
+	size_t encoded_size(World const& world);
+	// writes the world file of `world` into the encoded_size(world) bytes at `out`
+	void encode(World const& world, void* out);
+	// the World of the world file held in the `size` bytes at `data`, its balls are copied
+	World decode(void const* data, size_t size);
+	// maps the world file held in the POSIX shared memory block `name` (for instance the name of a Python SharedMemory),
+	// the balls borrow its columns privately, like load()
+	World load_shared(std::string const& name);
+}
+
+#endif
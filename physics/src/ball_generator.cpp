@@ -0,0 +1,144 @@
+#include "physics/ball_generator.hpp"
+#include "physics/json_writer.hpp"
+#include "physics/parallel.hpp"
+#include "physics/globals.h"  // Globals::lerp
+#include <algorithm>  // std::min, std::copy
+#include <cmath>
+
+// sequences shorter than this are not worth a thread
+static constexpr size_t MIN_CHUNK = 1 << 16;
+
+// i-th of n evenly spaced values from start to end, equal to Globals::linspace(start, end, n)[i]
+static double linspace_at(double start, double end, size_t n, size_t i) {
+	if (i + 1 == n)
+		return n == 1 ? start : end;
+	return start + (end - start) / (n - 1) * i;
+}
+
+// SplitMix64, used as a counter-based generator
+static uint64_t mix(uint64_t x) {
+	x += 0x9E3779B97F4A7C15;
+	x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9;
+	x = (x ^ (x >> 27)) * 0x94D049BB133111EB;
+	return x ^ (x >> 31);
+}
+
+// uniform double in [0, 1)
+static double unit(uint64_t x) {
+	return (x >> 11) * 0x1.0p-53;
+}
+
+static std::string to_json(char const* class_name, auto&& write_parameters) {
+	std::string ret;
+	JsonWriter out(&ret);
+	out.raw("{\"class\":\"").raw(class_name).raw("\",\"parameters\":{");
+	write_parameters(out);
+	out.raw("}}");
+	out.flush();
+	return ret;
+}
+
+void BallGenerator::append(Balls& balls) const {
+	size_t first(balls.size()), n(size());
+	balls.resize(first + n);
+	unsigned int nchunks(std::min<size_t>(Parallel::hardware_threads(), n / MIN_CHUNK + 1));
+	Parallel::for_chunks(n, nchunks, [&](unsigned int, size_t begin, size_t end) {
+		generate(begin, end, balls.pos.data() + first + begin, balls.vel.data() + first + begin);
+		std::copy(balls.pos.begin() + first + begin, balls.pos.begin() + first + end, balls.pos_prev.begin() + first + begin);
+	});
+}
+
+//
+// LineGenerator
+//
+
+void LineGenerator::generate(size_t begin, size_t end, vec2* pos, vec2* vel) const {
+	for (size_t i(begin); i < end; ++i) {
+		pos[i - begin] = vec2(linspace_at(p1.x, p2.x, n, i), linspace_at(p1.y, p2.y, n, i));
+		vel[i - begin] = this->vel;
+	}
+}
+
+std::string LineGenerator::str() const {
+	return "LineGenerator(p1=" + p1.str() + ", p2=" + p2.str() + ", vel=" + vel.str() + ", n=" + std::to_string(n) + ")";
+}
+
+std::string LineGenerator::json() const {
+	return to_json("LineGenerator", [&](JsonWriter& out) {
+		out.raw("\"p1\":").vec(p1).raw(",\"p2\":").vec(p2).raw(",\"vel\":").vec(vel).raw(",\"n\":").integer(n);
+	});
+}
+
+//
+// FanGenerator
+//
+
+void FanGenerator::generate(size_t begin, size_t end, vec2* pos, vec2* vel) const {
+	for (size_t i(begin); i < end; ++i) {
+		double angle(linspace_at(angle_min, angle_max, n, i));
+		pos[i - begin] = p0;
+		vel[i - begin] = vec2(std::cos(angle), std::sin(angle)) * speed;
+	}
+}
+
+std::string FanGenerator::str() const {
+	return "FanGenerator(p0=" + p0.str() + ", angle_min=" + std::to_string(angle_min) + ", angle_max=" + std::to_string(angle_max)
+		+ ", speed=" + std::to_string(speed) + ", n=" + std::to_string(n) + ")";
+}
+
+std::string FanGenerator::json() const {
+	return to_json("FanGenerator", [&](JsonWriter& out) {
+		out.raw("\"p0\":").vec(p0).raw(",\"angle_min\":").number(angle_min).raw(",\"angle_max\":").number(angle_max)
+			.raw(",\"speed\":").number(speed).raw(",\"n\":").integer(n);
+	});
+}
+
+//
+// GridGenerator
+//
+
+void GridGenerator::generate(size_t begin, size_t end, vec2* pos, vec2* vel) const {
+	for (size_t i(begin); i < end; ++i) {
+		size_t row(i / nx), col(i % nx);
+		pos[i - begin] = vec2(linspace_at(pmin.x, pmax.x, nx, col), linspace_at(pmin.y, pmax.y, ny, row));
+		vel[i - begin] = this->vel;
+	}
+}
+
+std::string GridGenerator::str() const {
+	return "GridGenerator(pmin=" + pmin.str() + ", pmax=" + pmax.str() + ", vel=" + vel.str()
+		+ ", nx=" + std::to_string(nx) + ", ny=" + std::to_string(ny) + ")";
+}
+
+std::string GridGenerator::json() const {
+	return to_json("GridGenerator", [&](JsonWriter& out) {
+		out.raw("\"pmin\":").vec(pmin).raw(",\"pmax\":").vec(pmax).raw(",\"vel\":").vec(vel)
+			.raw(",\"nx\":").integer(nx).raw(",\"ny\":").integer(ny);
+	});
+}
+
+//
+// UniformGenerator
+//
+
+void UniformGenerator::generate(size_t begin, size_t end, vec2* pos, vec2* vel) const {
+	for (size_t i(begin); i < end; ++i) {
+		// three draws per ball, from consecutive counters
+		uint64_t counter(mix(seed) + 3*i);
+		double angle(2*M_PI * unit(mix(counter + 2)));
+		pos[i - begin] = vec2(Globals::lerp(pmin.x, pmax.x, unit(mix(counter))), Globals::lerp(pmin.y, pmax.y, unit(mix(counter + 1))));
+		vel[i - begin] = vec2(std::cos(angle), std::sin(angle)) * speed;
+	}
+}
+
+std::string UniformGenerator::str() const {
+	return "UniformGenerator(pmin=" + pmin.str() + ", pmax=" + pmax.str() + ", speed=" + std::to_string(speed)
+		+ ", n=" + std::to_string(n) + ", seed=" + std::to_string(seed) + ")";
+}
+
+std::string UniformGenerator::json() const {
+	return to_json("UniformGenerator", [&](JsonWriter& out) {
+		out.raw("\"pmin\":").vec(pmin).raw(",\"pmax\":").vec(pmax).raw(",\"speed\":").number(speed)
+			.raw(",\"n\":").integer(n).raw(",\"seed\":").integer(seed);
+	});
+}
@@ -0,0 +1,75 @@
+#include "physics/density.hpp"
+#include <algorithm>  // std::fill
+#include <bit>  // std::endian
+#include <cstdio>  // std::FILE, std::fopen
+#include <numeric>  // std::accumulate
+#include <stdexcept>  // std::runtime_error
+
+namespace Density {
+
+Accumulator::Accumulator(Settings const& settings)
+	: settings_(settings), totals(settings.nx * settings.ny, 0) {}
+
+void Accumulator::prepare(unsigned int nthreads) {
+	if (partials.size() < nthreads)
+		partials.resize(nthreads);
+	for (std::vector<double>& partial : partials)
+		partial.resize(totals.size(), 0);
+}
+
+void Accumulator::sample(unsigned int thread, vec2 const* pos, size_t n, double dt) {
+	std::vector<double>& partial(partials[thread]);
+	if (partial.empty())
+		return;
+	double weight(settings_.weight_by_dt ? dt : 1);
+	double sx(settings_.nx / (settings_.grid_max.x - settings_.grid_min.x));
+	double sy(settings_.ny / (settings_.grid_max.y - settings_.grid_min.y));
+	for (size_t i(0); i < n; ++i) {
+		double fx((pos[i].x - settings_.grid_min.x) * sx);
+		double fy((pos[i].y - settings_.grid_min.y) * sy);
+		// balls outside of the grid (or NaN positions) are not binned
+		if (!(0 <= fx && fx < settings_.nx && 0 <= fy && fy < settings_.ny))
+			continue;
+		partial[size_t(fy) * settings_.nx + size_t(fx)] += weight;
+	}
+}
+
+void Accumulator::merge() {
+	for (std::vector<double>& partial : partials) {
+		for (size_t i(0); i < partial.size(); ++i)
+			totals[i] += partial[i];
+		std::fill(partial.begin(), partial.end(), 0);
+	}
+}
+
+void Accumulator::reset() {
+	for (std::vector<double>& partial : partials)
+		std::fill(partial.begin(), partial.end(), 0);
+	std::fill(totals.begin(), totals.end(), 0);
+	steps_ = 0;
+}
+
+double Accumulator::total() const {
+	return std::accumulate(totals.begin(), totals.end(), 0.0);
+}
+
+void Accumulator::save_npy(std::string const& filepath) const {
+	std::FILE* file(std::fopen(filepath.c_str(), "wb"));
+	if (file == nullptr)
+		throw std::runtime_error("failed to open file `" + filepath + "`");
+	// format 1.0: magic, version, little-endian header length, then a dict padded to a multiple of 64 bytes
+	std::string header("{'descr': '" + std::string(std::endian::native == std::endian::little ? "<f8" : ">f8")
+		+ "', 'fortran_order': False, 'shape': (" + std::to_string(settings_.ny) + ", " + std::to_string(settings_.nx) + "), }");
+	header.append(63 - (10 + header.size()) % 64, ' ');
+	header += '\n';
+	unsigned char preamble[10] = {0x93, 'N', 'U', 'M', 'P', 'Y', 1, 0,
+		(unsigned char)(header.size() & 0xff), (unsigned char)(header.size() >> 8)};
+	bool ok(std::fwrite(preamble, 1, sizeof(preamble), file) == sizeof(preamble)
+		&& std::fwrite(header.data(), 1, header.size(), file) == header.size()
+		&& std::fwrite(totals.data(), sizeof(double), totals.size(), file) == totals.size());
+	ok = std::fclose(file) == 0 && ok;
+	if (!ok)
+		throw std::runtime_error("failed to write file `" + filepath + "`");
+}
+
+}
@@ -0,0 +1,344 @@
+#include "physics/events.hpp"
+#include <chrono>
+#include <stdexcept>  // std::runtime_error
+#include <algorithm>  // std::min, std::stable_sort, std::upper_bound
+#include <cstring>  // std::memcmp, std::memcpy
+#include <utility>  // std::exchange
+
+static_assert(sizeof(Events::Bounce) == 64, "Bounce records are written to files as-is");
+static_assert(sizeof(Events::LogHeader) == 64, "event log headers are written as-is");
+
+namespace Events {
+
+//
+// FileSink
+//
+
+FileSink::FileSink(std::string const& filepath)
+	: filepath(filepath), file(std::fopen(filepath.c_str(), "wb")) {
+	if (file == nullptr)
+		throw std::runtime_error("failed to open file `" + filepath + "`");
+}
+
+FileSink::~FileSink() {
+	try { close(); }
+	catch (...) {}
+}
+
+void FileSink::consume(Bounce const* bounces, size_t n) {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (n > 0 && (file == nullptr || std::fwrite(bounces, sizeof(Bounce), n, file) != n))
+		failed_ = true;
+}
+
+void FileSink::flush() {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (file != nullptr && std::fflush(file) != 0)
+		failed_ = true;
+}
+
+bool FileSink::failed() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return failed_;
+}
+
+void FileSink::close() {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (file != nullptr && std::fclose(std::exchange(file, nullptr)) != 0)
+		failed_ = true;
+	if (failed_)
+		throw std::runtime_error("failed to write file `" + filepath + "`");
+}
+
+//
+// LogSink
+//
+
+LogSink::LogSink(std::string const& filepath, double time, Balls const& balls)
+	: filepath(filepath), file(std::fopen(filepath.c_str(), "wb")) {
+	if (file == nullptr)
+		throw std::runtime_error("failed to open file `" + filepath + "`");
+	LogHeader header{};
+	std::memcpy(header.magic, LOG_MAGIC, sizeof(LOG_MAGIC));
+	header.version = LOG_VERSION;
+	header.byte_order = LOG_BYTE_ORDER_MARK;
+	header.nballs = balls.size();
+	header.time = time;
+	bool ok(std::fwrite(&header, sizeof(LogHeader), 1, file) == 1);
+	ok = ok && std::fwrite(balls.pos.data(), sizeof(vec2), balls.size(), file) == balls.size();
+	ok = ok && std::fwrite(balls.vel.data(), sizeof(vec2), balls.size(), file) == balls.size();
+	if (!ok) {
+		std::fclose(file);
+		throw std::runtime_error("failed to write file `" + filepath + "`");
+	}
+}
+
+LogSink::~LogSink() {
+	try { close(); }
+	catch (...) {}
+}
+
+void LogSink::consume(Bounce const* bounces, size_t n) {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (n > 0 && (file == nullptr || std::fwrite(bounces, sizeof(Bounce), n, file) != n))
+		failed_ = true;
+}
+
+void LogSink::flush() {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (file != nullptr && std::fflush(file) != 0)
+		failed_ = true;
+}
+
+bool LogSink::failed() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return failed_;
+}
+
+void LogSink::close() {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (file != nullptr && std::fclose(std::exchange(file, nullptr)) != 0)
+		failed_ = true;
+	if (failed_)
+		throw std::runtime_error("failed to write file `" + filepath + "`");
+}
+
+//
+// Reconstructor
+//
+
+static std::runtime_error invalid_log(std::string const& filepath, std::string const& reason) {
+	return std::runtime_error("invalid event log `" + filepath + "`: " + reason);
+}
+
+Reconstructor::Reconstructor(std::string const& filepath) {
+	std::FILE* file(std::fopen(filepath.c_str(), "rb"));
+	if (file == nullptr)
+		throw std::runtime_error("failed to open file `" + filepath + "`");
+	std::shared_ptr<std::FILE> closer(file, std::fclose);
+
+	LogHeader header;
+	if (std::fread(&header, sizeof(LogHeader), 1, file) != 1)
+		throw invalid_log(filepath, "file too small");
+	if (std::memcmp(header.magic, LOG_MAGIC, sizeof(LOG_MAGIC)) != 0)
+		throw invalid_log(filepath, "bad magic");
+	if (header.byte_order != LOG_BYTE_ORDER_MARK)
+		throw invalid_log(filepath, "written on a machine of different endianness");
+	if (header.version != LOG_VERSION)
+		throw invalid_log(filepath, "unsupported version " + std::to_string(header.version));
+	if (std::fseek(file, 0, SEEK_END) != 0)
+		throw std::runtime_error("failed to read file `" + filepath + "`");
+	long size(std::ftell(file));
+	if (size < 0 || header.nballs > (size_t(size) - sizeof(LogHeader)) / (2*sizeof(vec2)))
+		throw invalid_log(filepath, "truncated initial state");
+	size_t records_bytes(size_t(size) - sizeof(LogHeader) - header.nballs * 2*sizeof(vec2));
+	// a partially written last record (the log was still being recorded) is ignored
+	size_t nrecords(records_bytes / sizeof(Bounce));
+
+	time0 = header.time;
+	pos0.resize(header.nballs);
+	vel0.resize(header.nballs);
+	bounces_.resize(nrecords);
+	bool ok(std::fseek(file, sizeof(LogHeader), SEEK_SET) == 0);
+	ok = ok && std::fread(pos0.data(), sizeof(vec2), pos0.size(), file) == pos0.size();
+	ok = ok && std::fread(vel0.data(), sizeof(vec2), vel0.size(), file) == vel0.size();
+	ok = ok && std::fread(bounces_.data(), sizeof(Bounce), nrecords, file) == nrecords;
+	if (!ok)
+		throw std::runtime_error("failed to read file `" + filepath + "`");
+
+	for (Bounce const& bounce : bounces_)
+		if (bounce.ball >= header.nballs)
+			throw invalid_log(filepath, "bounce of ball " + std::to_string(bounce.ball) + " which is not in the initial state");
+	// records of one ball may reach the sink out of order when the World was stepped by several threads,
+	// a stable sort keeps simultaneous bounces (corners) in the order they were resolved
+	std::stable_sort(bounces_.begin(), bounces_.end(), [](Bounce const& a, Bounce const& b) {
+		return a.ball != b.ball ? a.ball < b.ball : a.time < b.time;
+	});
+	first.assign(header.nballs + 1, 0);
+	for (Bounce const& bounce : bounces_)
+		++first[bounce.ball + 1];
+	for (size_t i(0); i < header.nballs; ++i)
+		first[i+1] += first[i];
+}
+
+Bounce const* Reconstructor::last_bounce(size_t ball, double time) const {
+	if (ball >= nballs())
+		throw std::out_of_range("ball index `" + std::to_string(ball) + "` out of range");
+	std::span<Bounce const> ball_bounces(bounces(ball));
+	auto it(std::upper_bound(ball_bounces.begin(), ball_bounces.end(), time, [](double t, Bounce const& bounce) {
+		return t < bounce.time;
+	}));
+	return it == ball_bounces.begin() ? nullptr : &*(it - 1);
+}
+
+vec2 Reconstructor::position(size_t ball, double time) const {
+	Bounce const* bounce(last_bounce(ball, time));
+	if (bounce == nullptr)
+		return pos0[ball] + vel0[ball] * (time - time0);
+	return bounce->pos + bounce->vel * (time - bounce->time);
+}
+
+vec2 Reconstructor::velocity(size_t ball, double time) const {
+	Bounce const* bounce(last_bounce(ball, time));
+	return bounce == nullptr ? vel0[ball] : bounce->vel;
+}
+
+void Reconstructor::positions(double time, vec2* out) const {
+	for (size_t i(0); i < nballs(); ++i)
+		out[i] = position(i, time);
+}
+
+//
+// CallbackSink
+//
+
+CallbackSink::CallbackSink(Callback callback, size_t batch_size)
+	: callback(callback), batch_size(batch_size == 0 ? 1 : batch_size) {
+	batch.reserve(this->batch_size);
+}
+
+void CallbackSink::consume(Bounce const* bounces, size_t n) {
+	while (n > 0) {
+		size_t k(std::min(n, batch_size - batch.size()));
+		batch.insert(batch.end(), bounces, bounces + k);
+		bounces += k;
+		n -= k;
+		if (batch.size() == batch_size) {
+			callback(batch);
+			batch.clear();
+		}
+	}
+}
+
+void CallbackSink::flush() {
+	if (batch.empty())
+		return;
+	callback(batch);
+	batch.clear();
+}
+
+//
+// HistogramSink
+//
+
+HistogramSink::HistogramSink(size_t nbins)
+	: nbins_(nbins == 0 ? 1 : nbins) {}
+
+void HistogramSink::consume(Bounce const* bounces, size_t n) {
+	std::lock_guard<std::mutex> lock(mutex);
+	for (size_t i(0); i < n; ++i) {
+		Bounce const& bounce(bounces[i]);
+		if ((bounce.curve+1) * nbins_ > bins.size())
+			bins.resize((bounce.curve+1) * nbins_, 0);
+		// clamp, the collision tolerance allows parameters slightly outside of [0, 1]
+		double t(bounce.t < 0 ? 0 : (bounce.t > 1 ? 1 : bounce.t));
+		size_t bin(std::min(size_t(t * nbins_), nbins_-1));
+		++bins[bounce.curve * nbins_ + bin];
+	}
+}
+
+size_t HistogramSink::ncurves() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return bins.size() / nbins_;
+}
+
+uint64_t HistogramSink::count(size_t curve, size_t bin) const {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (curve * nbins_ + bin >= bins.size())
+		return 0;
+	return bins[curve * nbins_ + bin];
+}
+
+uint64_t HistogramSink::count(size_t curve) const {
+	std::lock_guard<std::mutex> lock(mutex);
+	uint64_t total(0);
+	for (size_t bin(0); bin < nbins_ && curve * nbins_ + bin < bins.size(); ++bin)
+		total += bins[curve * nbins_ + bin];
+	return total;
+}
+
+std::vector<uint64_t> HistogramSink::counts() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return bins;
+}
+
+//
+// EventQueue
+//
+
+EventQueue::EventQueue(std::shared_ptr<Sink> sink, unsigned int nproducers, Settings const& settings)
+	: sink_(sink), settings_(settings), consumed_(0), running(true) {
+	if (!sink_)
+		throw std::invalid_argument("EventQueue needs a sink");
+	if (settings_.batch == 0)
+		settings_.batch = 1;
+	for (unsigned int i(0); i < (nproducers == 0 ? 1 : nproducers); ++i)
+		producers_.push_back(std::make_unique<Producer>(settings_.capacity));
+	consumer = std::thread(&EventQueue::consume, this);
+}
+
+EventQueue::~EventQueue() {
+	running.store(false, std::memory_order_release);
+	consumer.join();
+	std::vector<Bounce> buffer(settings_.batch);
+	while (drain(buffer) > 0) {}
+	std::lock_guard<std::mutex> lock(sink_mutex);
+	sink_->flush();
+}
+
+void EventQueue::flush() {
+	uint64_t target(pushed());
+	while (consumed() < target)
+		std::this_thread::yield();
+	std::lock_guard<std::mutex> lock(sink_mutex);
+	sink_->flush();
+}
+
+uint64_t EventQueue::pushed() const {
+	uint64_t total(0);
+	for (std::unique_ptr<Producer> const& p : producers_)
+		total += p->pushed.load(std::memory_order_relaxed);
+	return total;
+}
+
+uint64_t EventQueue::dropped() const {
+	uint64_t total(0);
+	for (std::unique_ptr<Producer> const& p : producers_)
+		total += p->dropped.load(std::memory_order_relaxed);
+	return total;
+}
+
+size_t EventQueue::drain(std::vector<Bounce>& buffer) {
+	size_t total(0);
+	// producers are visited in order, so records of one producer reach the sink in the order they were pushed
+	for (std::unique_ptr<Producer>& p : producers_) {
+		size_t n(p->ring.pop_bulk(buffer.data(), buffer.size()));
+		if (n == 0)
+			continue;
+		{
+			std::lock_guard<std::mutex> lock(sink_mutex);
+			sink_->consume(buffer.data(), n);
+		}
+		consumed_.fetch_add(n, std::memory_order_release);
+		total += n;
+	}
+	return total;
+}
+
+void EventQueue::consume() {
+	std::vector<Bounce> buffer(settings_.batch);
+	unsigned int idle(0);
+	while (running.load(std::memory_order_acquire)) {
+		if (drain(buffer) > 0) {
+			idle = 0;
+			continue;
+		}
+		// back off progressively when there is nothing to do
+		if (++idle < 64)
+			std::this_thread::yield();
+		else
+			std::this_thread::sleep_for(std::chrono::microseconds(100));
+	}
+}
+
+}
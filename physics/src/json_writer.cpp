@@ -0,0 +1,51 @@
+#include "physics/json_writer.hpp"
+#include <algorithm>  // std::max
+#include <stdexcept>  // std::runtime_error
+#include <cerrno>
+#include <fcntl.h>  // open
+#include <unistd.h>  // write, close
+
+JsonWriter::JsonWriter(std::string const& filepath, size_t capacity)
+	: JsonWriter(::open(filepath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644), capacity) {
+	if (fd < 0)
+		throw std::runtime_error("failed to open file `" + filepath + "`");
+	owns_fd = true;
+}
+
+JsonWriter::JsonWriter(int fd, size_t capacity)
+	: fd(fd), capacity(std::max(capacity, MAX_NUMBER_CHARS)) {
+	buffer.reset(new char[this->capacity]);
+}
+
+JsonWriter::JsonWriter(std::string* target, size_t capacity)
+	: target(target), capacity(std::max(capacity, MAX_NUMBER_CHARS)) {
+	buffer.reset(new char[this->capacity]);
+}
+
+JsonWriter::~JsonWriter() {
+	try { flush_buffer(); }
+	catch (...) {}
+	if (owns_fd)
+		::close(fd);
+}
+
+void JsonWriter::write_out(char const* data, size_t n) {
+	if (target != nullptr) {
+		target->append(data, n);
+		return;
+	}
+	while (n > 0) {
+		ssize_t written(::write(fd, data, n));
+		if (written < 0) {
+			if (errno == EINTR)
+				continue;
+			throw std::runtime_error("failed to write json output");
+		}
+		data += written;
+		n -= written;
+	}
+}
+
+void JsonWriter::flush() {
+	flush_buffer();
+}
@@ -0,0 +1,84 @@
+#include "physics/statistics.hpp"
+#include <algorithm>  // std::max, std::fill
+#include <cmath>
+
+namespace Statistics {
+
+void Accumulator::clear() {
+	samples = 0;
+	collisions = 0;
+	drift_violations = 0;
+	max_speed_drift = 0;
+	std::fill(curve_hits.begin(), curve_hits.end(), 0);
+	std::fill(occupancy.begin(), occupancy.end(), 0);
+}
+
+Collector::Collector(Settings const& settings)
+	: settings_(settings) {
+	if (settings_.merge_every == 0)
+		settings_.merge_every = 1;
+	totals.occupancy.resize(settings_.nx * settings_.ny, 0);
+}
+
+void Collector::prepare(unsigned int nthreads, size_t ncurves) {
+	if (accumulators.size() < nthreads)
+		accumulators.resize(nthreads);
+	if (totals.curve_hits.size() < ncurves)
+		totals.curve_hits.resize(ncurves, 0);
+	for (Accumulator& acc : accumulators) {
+		if (acc.curve_hits.size() < ncurves)
+			acc.curve_hits.resize(ncurves, 0);
+		acc.occupancy.resize(settings_.nx * settings_.ny, 0);
+	}
+}
+
+void Collector::sample(unsigned int thread, size_t ball, vec2 const& pos, vec2 const& vel) {
+	Accumulator& acc(accumulators[thread]);
+	++acc.samples;
+
+	double ref(speed0[ball]);
+	double drift(ref > 0 ? std::abs(vel.length()/ref - 1) : vel.length());
+	acc.max_speed_drift = std::max(acc.max_speed_drift, drift);
+	acc.drift_violations += drift > settings_.speed_tolerance;
+
+	if (acc.occupancy.empty())
+		return;
+	double fx((pos.x - settings_.grid_min.x) / (settings_.grid_max.x - settings_.grid_min.x));
+	double fy((pos.y - settings_.grid_min.y) / (settings_.grid_max.y - settings_.grid_min.y));
+	// balls outside of the grid (or NaN positions) are not binned
+	if (!(0 <= fx && fx < 1 && 0 <= fy && fy < 1))
+		return;
+	++acc.occupancy[size_t(fy * settings_.ny) * settings_.nx + size_t(fx * settings_.nx)];
+}
+
+void Collector::end_step() {
+	++steps_;
+	if (++unmerged_steps >= settings_.merge_every)
+		merge();
+}
+
+void Collector::merge() {
+	for (Accumulator& acc : accumulators) {
+		totals.samples += acc.samples;
+		totals.collisions += acc.collisions;
+		totals.drift_violations += acc.drift_violations;
+		totals.max_speed_drift = std::max(totals.max_speed_drift, acc.max_speed_drift);
+		for (size_t i(0); i < acc.curve_hits.size(); ++i)
+			totals.curve_hits[i] += acc.curve_hits[i];
+		for (size_t i(0); i < acc.occupancy.size(); ++i)
+			totals.occupancy[i] += acc.occupancy[i];
+		acc.clear();
+	}
+	unmerged_steps = 0;
+}
+
+void Collector::reset() {
+	for (Accumulator& acc : accumulators)
+		acc.clear();
+	totals.clear();
+	speed0.clear();
+	steps_ = 0;
+	unmerged_steps = 0;
+}
+
+}
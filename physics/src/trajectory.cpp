@@ -0,0 +1,304 @@
+#include "physics/trajectory.hpp"
+#include <bit>  // std::bit_cast, std::countl_zero, std::countr_zero
+#include <cstring>  // std::memcmp, std::memcpy
+#include <stdexcept>  // std::runtime_error
+#include <cerrno>
+#include <fcntl.h>  // open
+#include <unistd.h>  // pread, close
+
+static_assert(sizeof(Trajectory::Header) == 64, "trajectory headers are written as-is");
+static_assert(sizeof(Trajectory::ChunkRecord) == 32, "trajectory chunk records are written as-is");
+static_assert(sizeof(vec2) == 2*sizeof(double), "frames are decoded into vec2 arrays");
+
+namespace Trajectory {
+
+static std::runtime_error invalid(std::string const& filepath, std::string const& reason) {
+	return std::runtime_error("invalid trajectory file `" + filepath + "`: " + reason);
+}
+
+// prediction of the next value of `stream`, `k` is the index of the frame in its chunk
+// written as two additions so that it cannot be contracted differently by the encoder and the decoder
+static double predict(Stream const& stream, unsigned int k) {
+	if (k == 0)
+		return 0;
+	if (k == 1)
+		return stream.prev1;
+	return stream.prev1 + (stream.prev1 - stream.prev2);
+}
+
+static void advance(Stream& stream, double value) {
+	stream.prev2 = stream.prev1;
+	stream.prev1 = value;
+}
+
+static uint64_t mask(unsigned int n) {
+	return n == 64 ? ~uint64_t(0) : (uint64_t(1) << n) - 1;
+}
+
+//
+// Recorder
+//
+
+Recorder::Recorder(std::string const& filepath, Settings const& settings)
+	: filepath(filepath), settings_(settings), file(std::fopen(filepath.c_str(), "wb")), header{}, offset(sizeof(Header)) {
+	if (file == nullptr)
+		throw std::runtime_error("failed to open file `" + filepath + "`");
+	if (settings_.every == 0)
+		settings_.every = 1;
+	if (settings_.chunk_frames == 0)
+		settings_.chunk_frames = 1;
+	std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = VERSION;
+	header.byte_order = BYTE_ORDER_MARK;
+	header.every = settings_.every;
+	header.chunk_frames = settings_.chunk_frames;
+	// placeholder until close(), readers reject files without an index
+	if (std::fwrite(&header, sizeof(Header), 1, file) != 1) {
+		std::fclose(file);
+		throw std::runtime_error("failed to write file `" + filepath + "`");
+	}
+}
+
+Recorder::~Recorder() {
+	try { close(); }
+	catch (...) {}
+}
+
+void Recorder::write_bits(uint64_t value, unsigned int n) {
+	unsigned int free(64 - nbits);
+	if (n < free) {
+		acc |= value << (free - n);
+		nbits += n;
+		return;
+	}
+	// fill the current word with the high bits, start the next one with the rest
+	acc |= value >> (n - free);
+	words.push_back(acc);
+	n -= free;
+	acc = n == 0 ? 0 : value << (64 - n);
+	nbits = n;
+}
+
+void Recorder::encode(Stream& stream, double value) {
+	uint64_t x(std::bit_cast<uint64_t>(value) ^ std::bit_cast<uint64_t>(predict(stream, chunk_nframes)));
+	advance(stream, value);
+	if (x == 0) {
+		write_bits(0, 1);  // '0': exactly predicted
+		return;
+	}
+	unsigned int lead(std::countl_zero(x)), trail(std::countr_zero(x));
+	if (lead >= stream.lead && trail >= stream.trail) {
+		// '10': meaningful bits fit in the previous window
+		write_bits(0b10, 2);
+		write_bits(x >> stream.trail, 64 - stream.lead - stream.trail);
+		return;
+	}
+	// '11', 6 bits of leading zeros, 6 bits of length-1, meaningful bits
+	unsigned int len(64 - lead - trail);
+	write_bits((uint64_t(0b11) << 12) | (uint64_t(lead) << 6) | (len - 1), 14);
+	write_bits(x >> trail, len);
+	stream.lead = lead;
+	stream.trail = trail;
+}
+
+void Recorder::record(double time, Balls const& balls) {
+	if (file == nullptr)
+		throw std::runtime_error("trajectory recorder `" + filepath + "` is closed");
+	if (nframes_ == 0) {
+		header.nballs = balls.size();
+		streams.assign(1 + 4*balls.size(), Stream());
+	} else if (balls.size() != header.nballs) {
+		throw std::runtime_error("trajectory recorder `" + filepath + "` expects " + std::to_string(header.nballs)
+			+ " balls, got " + std::to_string(balls.size()));
+	}
+
+	encode(streams[0], time);
+	Stream* stream(streams.data() + 1);
+	for (size_t i(0); i < balls.size(); ++i, stream += 4) {
+		encode(stream[0], balls.pos[i].x);
+		encode(stream[1], balls.pos[i].y);
+		encode(stream[2], balls.vel[i].x);
+		encode(stream[3], balls.vel[i].y);
+	}
+	++nframes_;
+	if (++chunk_nframes == settings_.chunk_frames)
+		flush_chunk();
+}
+
+void Recorder::flush_chunk() {
+	if (chunk_nframes == 0)
+		return;
+	if (nbits > 0)
+		words.push_back(acc);
+	ChunkRecord rec{nframes_ - chunk_nframes, chunk_nframes, offset, words.size()*sizeof(uint64_t)};
+	if (std::fwrite(words.data(), sizeof(uint64_t), words.size(), file) != words.size())
+		throw std::runtime_error("failed to write file `" + filepath + "`");
+	index.push_back(rec);
+	offset += rec.bytes;
+
+	// the next chunk is decoded independently
+	words.clear();
+	acc = 0;
+	nbits = 0;
+	chunk_nframes = 0;
+	for (Stream& stream : streams)
+		stream = Stream();
+}
+
+void Recorder::close() {
+	if (file == nullptr)
+		return;
+	bool ok(true);
+	try { flush_chunk(); }
+	catch (std::runtime_error const&) { ok = false; }
+	std::FILE* f(file);
+	file = nullptr;  // closed even if writing fails
+	header.nframes = nframes_;
+	header.nchunks = index.size();
+	header.index_offset = offset;
+	ok = ok && std::fwrite(index.data(), sizeof(ChunkRecord), index.size(), f) == index.size();
+	ok = ok && std::fseek(f, 0, SEEK_SET) == 0;
+	ok = ok && std::fwrite(&header, sizeof(Header), 1, f) == 1;
+	ok = std::fclose(f) == 0 && ok;
+	if (!ok)
+		throw std::runtime_error("failed to write file `" + filepath + "`");
+}
+
+//
+// Reader
+//
+
+// reads a chunk bitstream, most significant bits first
+class BitReader {
+	uint64_t const* word;
+	uint64_t const* end;
+	uint64_t cur = 0;
+	unsigned int avail = 0;  // unread low bits of `cur`
+	std::string const& filepath;
+
+	uint64_t next_word() {
+		if (word == end)
+			throw invalid(filepath, "corrupted chunk");
+		return *word++;
+	}
+
+public:
+	BitReader(std::vector<uint64_t> const& words, std::string const& filepath)
+		: word(words.data()), end(words.data() + words.size()), filepath(filepath) {}
+
+	uint64_t read(unsigned int n) {
+		if (n <= avail) {
+			avail -= n;
+			return (cur >> avail) & mask(n);
+		}
+		uint64_t high(cur & mask(avail));
+		unsigned int rest(n - avail);
+		cur = next_word();
+		avail = 64 - rest;
+		return (rest == 64 ? 0 : high << rest) | (cur >> avail);
+	}
+
+	double decode(Stream& stream, unsigned int k) {
+		uint64_t x(0);
+		if (read(1) == 1) {
+			if (read(1) == 0) {
+				x = read(64 - stream.lead - stream.trail) << stream.trail;
+			} else {
+				uint64_t bits(read(12));
+				unsigned int lead(bits >> 6), len((bits & 63) + 1);
+				if (lead + len > 64)
+					throw invalid(filepath, "corrupted chunk");
+				stream.lead = lead;
+				stream.trail = 64 - lead - len;
+				x = read(len) << stream.trail;
+			}
+		}
+		double value(std::bit_cast<double>(x ^ std::bit_cast<uint64_t>(predict(stream, k))));
+		advance(stream, value);
+		return value;
+	}
+};
+
+Reader::Reader(std::string const& filepath)
+	: filepath(filepath), fd(::open(filepath.c_str(), O_RDONLY)) {
+	if (fd < 0)
+		throw std::runtime_error("failed to open file `" + filepath + "`");
+	try {
+		if (::pread(fd, &header, sizeof(Header), 0) != ssize_t(sizeof(Header)))
+			throw invalid(filepath, "file too small");
+		if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0)
+			throw invalid(filepath, "bad magic");
+		if (header.byte_order != BYTE_ORDER_MARK)
+			throw invalid(filepath, "written on a machine of different endianness");
+		if (header.version != VERSION)
+			throw invalid(filepath, "unsupported version " + std::to_string(header.version));
+		if (header.index_offset == 0)
+			throw invalid(filepath, "recording was not closed");
+		if (header.nchunks > (SIZE_MAX - header.index_offset) / sizeof(ChunkRecord))
+			throw invalid(filepath, "chunk index out of bounds");
+		index.resize(header.nchunks);
+		size_t index_bytes(header.nchunks * sizeof(ChunkRecord));
+		if (::pread(fd, index.data(), index_bytes, header.index_offset) != ssize_t(index_bytes))
+			throw invalid(filepath, "truncated chunk index");
+		uint64_t nframes(0);
+		for (ChunkRecord const& rec : index) {
+			if (rec.first_frame != nframes || rec.bytes % sizeof(uint64_t) != 0
+				|| rec.offset > header.index_offset || rec.bytes > header.index_offset - rec.offset)
+				throw invalid(filepath, "inconsistent chunk index");
+			nframes += rec.nframes;
+		}
+		if (nframes != header.nframes)
+			throw invalid(filepath, "inconsistent chunk index");
+	} catch (...) {
+		::close(fd);
+		throw;
+	}
+}
+
+Reader::~Reader() {
+	::close(fd);
+}
+
+void Reader::read(size_t first, size_t n, double* times, vec2* pos, vec2* vel) const {
+	if (first > header.nframes || n > header.nframes - first)
+		throw std::out_of_range("frames [" + std::to_string(first) + ", " + std::to_string(first + n) + ") out of range, the trajectory has "
+			+ std::to_string(header.nframes) + " frames");
+	size_t nballs(header.nballs);
+	std::vector<uint64_t> words;
+	std::vector<Stream> streams;
+
+	for (ChunkRecord const& rec : index) {
+		if (rec.first_frame + rec.nframes <= first || rec.first_frame >= first + n)
+			continue;
+		words.resize(rec.bytes / sizeof(uint64_t));
+		if (::pread(fd, words.data(), rec.bytes, rec.offset) != ssize_t(rec.bytes))
+			throw invalid(filepath, "truncated chunk");
+		streams.assign(1 + 4*nballs, Stream());
+		BitReader bits(words, filepath);
+
+		// frames have to be decoded in order, the ones before `first` are discarded
+		for (unsigned int k(0); k < rec.nframes; ++k) {
+			size_t frame(rec.first_frame + k);
+			if (frame >= first + n)
+				break;
+			bool keep(frame >= first);
+			double time(bits.decode(streams[0], k));
+			if (keep && times != nullptr)
+				times[frame - first] = time;
+			Stream* stream(streams.data() + 1);
+			for (size_t i(0); i < nballs; ++i, stream += 4) {
+				vec2 p, v;
+				p.x = bits.decode(stream[0], k);
+				p.y = bits.decode(stream[1], k);
+				v.x = bits.decode(stream[2], k);
+				v.y = bits.decode(stream[3], k);
+				if (keep && pos != nullptr)
+					pos[(frame - first)*nballs + i] = p;
+				if (keep && vel != nullptr)
+					vel[(frame - first)*nballs + i] = v;
+			}
+		}
+	}
+}
+
+}
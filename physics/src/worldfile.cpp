@@ -0,0 +1,242 @@
+#include "physics/worldfile.hpp"
+#include <cstdio>  // std::FILE
+#include <cstring>  // std::memcmp, std::memcpy, std::memset
+#include <memory>  // std::shared_ptr, std::make_shared
+#include <stdexcept>  // std::runtime_error
+#include <fcntl.h>  // open
+#include <sys/mman.h>  // mmap, munmap, shm_open
+#include <sys/stat.h>  // fstat
+#include <unistd.h>  // close
+
+static_assert(sizeof(WorldFile::Header) == 64, "world file headers are written as-is");
+static_assert(sizeof(WorldFile::CurveRecord) == 80, "world file curve records are written as-is");
+static_assert(sizeof(vec2) == 2*sizeof(double), "ball columns are written as-is");
+
+namespace WorldFile {
+
+static std::runtime_error invalid(std::string const& filepath, std::string const& reason) {
+	return std::runtime_error("invalid world file `" + filepath + "`: " + reason);
+}
+
+static CurveRecord to_record(Curve const& curve) {
+	CurveRecord rec{};
+	double* p(rec.params);
+	if (Line const* line = dynamic_cast<Line const*>(&curve)) {
+		rec.kind = uint32_t(CurveKind::LINE);
+		p[0] = line->p; p[1] = line->q; p[2] = line->r;
+	} else if (Segment const* seg = dynamic_cast<Segment const*>(&curve)) {
+		rec.kind = uint32_t(CurveKind::SEGMENT);
+		p[0] = seg->p1.x; p[1] = seg->p1.y; p[2] = seg->p2.x; p[3] = seg->p2.y;
+	} else if (Arc const* arc = dynamic_cast<Arc const*>(&curve)) {
+		rec.kind = uint32_t(CurveKind::ARC);
+		p[0] = arc->p0.x; p[1] = arc->p0.y; p[2] = arc->r; p[3] = arc->theta_min; p[4] = arc->theta_max;
+	} else if (Ellipse const* ell = dynamic_cast<Ellipse const*>(&curve)) {
+		rec.kind = uint32_t(CurveKind::ELLIPSE);
+		p[0] = ell->p0.x; p[1] = ell->p0.y; p[2] = ell->a; p[3] = ell->b; p[4] = ell->phi; p[5] = ell->theta_min; p[6] = ell->theta_max;
+	} else if (BezierCubic const* bez = dynamic_cast<BezierCubic const*>(&curve)) {
+		rec.kind = uint32_t(CurveKind::BEZIER_CUBIC);
+		p[0] = bez->p0.x; p[1] = bez->p0.y; p[2] = bez->p1.x; p[3] = bez->p1.y;
+		p[4] = bez->p2.x; p[5] = bez->p2.y; p[6] = bez->p3.x; p[7] = bez->p3.y;
+	} else {
+		throw std::runtime_error("cannot write curve " + curve.str() + " to a world file");
+	}
+	return rec;
+}
+
+// the members are assigned directly (not through the constructors, which normalize the angles)
+// so that a save/load round trip is exact
+static std::shared_ptr<Curve> from_record(CurveRecord const& rec, std::string const& filepath) {
+	double const* p(rec.params);
+	switch (CurveKind(rec.kind)) {
+		case CurveKind::LINE:
+			return std::make_shared<Line>(p[0], p[1], p[2]);
+		case CurveKind::SEGMENT:
+			return std::make_shared<Segment>(vec2(p[0], p[1]), vec2(p[2], p[3]));
+		case CurveKind::ARC: {
+			std::shared_ptr<Arc> arc(std::make_shared<Arc>());
+			arc->p0 = vec2(p[0], p[1]); arc->r = p[2]; arc->theta_min = p[3]; arc->theta_max = p[4];
+			return arc;
+		}
+		case CurveKind::ELLIPSE: {
+			std::shared_ptr<Ellipse> ell(std::make_shared<Ellipse>());
+			ell->p0 = vec2(p[0], p[1]); ell->a = p[2]; ell->b = p[3]; ell->phi = p[4]; ell->theta_min = p[5]; ell->theta_max = p[6];
+			return ell;
+		}
+		case CurveKind::BEZIER_CUBIC:
+			return std::make_shared<BezierCubic>(vec2(p[0], p[1]), vec2(p[2], p[3]), vec2(p[4], p[5]), vec2(p[6], p[7]));
+	}
+	throw invalid(filepath, "unknown curve kind " + std::to_string(rec.kind));
+}
+
+bool is_world_file(std::string const& filepath) {
+	std::FILE* file(std::fopen(filepath.c_str(), "rb"));
+	if (file == nullptr)
+		return false;
+	char magic[sizeof(MAGIC)];
+	bool ret(std::fread(magic, 1, sizeof(magic), file) == sizeof(magic) && std::memcmp(magic, MAGIC, sizeof(MAGIC)) == 0);
+	std::fclose(file);
+	return ret;
+}
+
+// the header and curve table of `world`
+static Header make_header(World const& world, std::vector<CurveRecord>& records) {
+	records.clear();
+	records.reserve(world.curve_ptrs.size());
+	for (std::shared_ptr<Curve> const& curve_ptr : world.curve_ptrs)
+		records.push_back(to_record(*curve_ptr));
+
+	size_t nballs(world.balls.size());
+	Header header{};
+	std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = VERSION;
+	header.byte_order = BYTE_ORDER_MARK;
+	header.ncurves = records.size();
+	header.nballs = nballs;
+	header.curves_offset = sizeof(Header);
+	size_t table_end(sizeof(Header) + records.size()*sizeof(CurveRecord));
+	header.balls_offset = (table_end + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+	header.file_size = header.balls_offset + 3*column_bytes(nballs);
+	header.time = world.time;
+	return header;
+}
+
+void save(World const& world, std::string const& filepath) {
+	std::vector<CurveRecord> records;
+	Header header(make_header(world, records));
+	size_t nballs(header.nballs);
+	size_t table_end(sizeof(Header) + records.size()*sizeof(CurveRecord));
+
+	std::FILE* file(std::fopen(filepath.c_str(), "wb"));
+	if (file == nullptr)
+		throw std::runtime_error("failed to open file `" + filepath + "`");
+	char const zeros[ALIGNMENT] = {};
+	bool ok(std::fwrite(&header, sizeof(Header), 1, file) == 1);
+	ok = ok && std::fwrite(records.data(), sizeof(CurveRecord), records.size(), file) == records.size();
+	ok = ok && std::fwrite(zeros, 1, header.balls_offset - table_end, file) == header.balls_offset - table_end;
+	for (Column<vec2> const* column : {&world.balls.pos, &world.balls.pos_prev, &world.balls.vel}) {
+		size_t padding(column_bytes(nballs) - nballs*sizeof(vec2));
+		ok = ok && std::fwrite(column->data(), sizeof(vec2), nballs, file) == nballs;
+		ok = ok && std::fwrite(zeros, 1, padding, file) == padding;
+	}
+	ok = std::fclose(file) == 0 && ok;
+	if (!ok)
+		throw std::runtime_error("failed to write file `" + filepath + "`");
+}
+
+size_t encoded_size(World const& world) {
+	size_t table_end(sizeof(Header) + world.curve_ptrs.size()*sizeof(CurveRecord));
+	return (table_end + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT + 3*column_bytes(world.balls.size());
+}
+
+void encode(World const& world, void* out) {
+	std::vector<CurveRecord> records;
+	Header header(make_header(world, records));
+	size_t nballs(header.nballs);
+	char* bytes(static_cast<char*>(out));
+	std::memset(bytes, 0, header.file_size);  // padding
+	std::memcpy(bytes, &header, sizeof(Header));
+	if (!records.empty())
+		std::memcpy(bytes + header.curves_offset, records.data(), records.size()*sizeof(CurveRecord));
+	char* column(bytes + header.balls_offset);
+	for (Column<vec2> const* source : {&world.balls.pos, &world.balls.pos_prev, &world.balls.vel}) {
+		if (nballs > 0)
+			std::memcpy(column, source->data(), nballs*sizeof(vec2));
+		column += column_bytes(nballs);
+	}
+}
+
+// the World held in the `size` bytes at `bytes`, named `name` in errors
+// with an `owner`, the balls borrow the columns (which must then stay writable and alive as long as it), otherwise
+// they are copied. Memory larger than the world file (`exact` false) is accepted, the rest is ignored.
+static World from_image(char* bytes, size_t size, std::shared_ptr<void> owner, std::string const& name, bool exact) {
+	if (size < sizeof(Header))
+		throw invalid(name, "file too small");
+	Header header;
+	std::memcpy(&header, bytes, sizeof(Header));
+	if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0)
+		throw invalid(name, "bad magic");
+	if (header.byte_order != BYTE_ORDER_MARK)
+		throw invalid(name, "written on a machine of different endianness");
+	if (header.version != VERSION)
+		throw invalid(name, "unsupported version " + std::to_string(header.version));
+	if (exact ? header.file_size != size : header.file_size > size)
+		throw invalid(name, "truncated (expected " + std::to_string(header.file_size) + " bytes, got " + std::to_string(size) + ")");
+	size = header.file_size;
+	// the divisions keep the bound checks safe from overflow with corrupted counts
+	if (header.curves_offset > size || header.ncurves > (size - header.curves_offset) / sizeof(CurveRecord))
+		throw invalid(name, "curve table out of bounds");
+	if (header.balls_offset % ALIGNMENT != 0)
+		throw invalid(name, "misaligned ball columns");
+	if (header.balls_offset > size || header.nballs > (size - header.balls_offset) / (3*sizeof(vec2))
+		|| header.balls_offset + 3*column_bytes(header.nballs) > size)
+		throw invalid(name, "ball columns out of bounds");
+
+	World world;
+	world.time = header.time;
+	world.curve_ptrs.reserve(header.ncurves);
+	for (size_t i(0); i < header.ncurves; ++i) {
+		CurveRecord rec;
+		std::memcpy(&rec, bytes + header.curves_offset + i*sizeof(CurveRecord), sizeof(CurveRecord));
+		world.add_curve(from_record(rec, name));
+	}
+
+	size_t nballs(header.nballs);
+	vec2* columns(reinterpret_cast<vec2*>(bytes + header.balls_offset));
+	size_t stride(column_bytes(nballs) / sizeof(vec2));
+	if (owner) {
+		world.balls.pos.borrow(columns, nballs, owner);
+		world.balls.pos_prev.borrow(columns + stride, nballs, owner);
+		world.balls.vel.borrow(columns + 2*stride, nballs, owner);
+	} else {
+		world.balls.append(columns, columns + 2*stride, nballs, columns + stride);
+	}
+	return world;
+}
+
+World decode(void const* data, size_t size) {
+	// the columns are only read when copied
+	return from_image(static_cast<char*>(const_cast<void*>(data)), size, nullptr, "buffer", true);
+}
+
+// maps `fd` (closed on return) and decodes it
+static World map_world(int fd, std::string const& name, bool borrow, bool exact) {
+	struct stat st;
+	if (::fstat(fd, &st) != 0) {
+		::close(fd);
+		throw std::runtime_error("failed to open file `" + name + "`");
+	}
+	size_t size(st.st_size);
+	if (size < sizeof(Header)) {
+		::close(fd);
+		throw invalid(name, "file too small");
+	}
+	// private writable mapping: stepping the World copies the touched pages, the file is never modified
+	void* base(::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0));
+	::close(fd);
+	if (base == MAP_FAILED)
+		throw std::runtime_error("failed to map file `" + name + "`");
+	std::shared_ptr<void> mapping(base, [size](void* ptr) { ::munmap(ptr, size); });
+	// without borrowing, the balls are copied and the mapping is released on return
+	return from_image(static_cast<char*>(base), size, borrow ? mapping : nullptr, name, exact);
+}
+
+World load(std::string const& filepath, bool map) {
+	int fd(::open(filepath.c_str(), O_RDONLY));
+	if (fd < 0)
+		throw std::runtime_error("failed to open file `" + filepath + "`");
+	return map_world(fd, filepath, map, true);
+}
+
+World load_shared(std::string const& name) {
+	// the names of Python's SharedMemory blocks do not start with the slash of POSIX names
+	std::string path(name);
+	if (!path.starts_with('/'))
+		path.insert(0, 1, '/');
+	int fd(::shm_open(path.c_str(), O_RDONLY, 0));
+	if (fd < 0)
+		throw std::runtime_error("failed to open shared memory `" + name + "`");
+	// the block may be rounded up to a whole number of pages
+	return map_world(fd, name, true, false);
+}
+
+}
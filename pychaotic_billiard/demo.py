@@ -3,6 +3,7 @@
 # TODO : temp directory
 
 from physics import World, Segment, Arc, BezierCubic, Ball, vec2
+import numpy as np
 
 if __name__ == '__main__':
 	import pyglet
@@ -32,12 +33,15 @@ if __name__ == '__main__':
 		glClearColor(0.0, 0.0, 0.0, 0.0)
 		glClear(GL_COLOR_BUFFER_BIT)
 
+		# the (nballs, 2) positions are drawn straight from the memory of the World
+		positions = world.positions
 		glPointSize(1)
 		glColor3f(0.0, 1.0, 0.5)
-		glBegin(GL_POINTS)
-		for ball in world.balls:
-			glVertex2f(*ball.pos)
-		glEnd()
+		glEnableClientState(GL_VERTEX_ARRAY)
+		glVertexPointer(2, GL_DOUBLE, 0, positions.ctypes.data)
+		glDrawArrays(GL_POINTS, 0, len(positions))
+		glDisableClientState(GL_VERTEX_ARRAY)
+		del positions
 
 		segs = [curve for curve in world.curves if isinstance(curve, Segment)]
 		glLineWidth(1)
@@ -51,13 +55,13 @@ if __name__ == '__main__':
 		explcurves = [curve for curve in world.curves if isinstance(curve, BezierCubic) or isinstance(curve, Arc)]
 		glLineWidth(1)
 		glColor3f(0.5, 0.5, 0.5)
+		glEnableClientState(GL_VERTEX_ARRAY)
 		for explcurve in explcurves:
-			glBegin(GL_LINE_STRIP)
-			glVertex2f(*explcurve(0))
-			for i in range(CURVE_SAMPLE_SIZE):
-				glVertex2f(*explcurve(i/(CURVE_SAMPLE_SIZE-1)))
-			glVertex2f(*explcurve(1))
-			glEnd()
+			# all the samples of a curve are evaluated in a single call
+			points = explcurve.eval(np.linspace(0, 1, CURVE_SAMPLE_SIZE))
+			glVertexPointer(2, GL_DOUBLE, 0, points.ctypes.data)
+			glDrawArrays(GL_LINE_STRIP, 0, len(points))
+		glDisableClientState(GL_VERTEX_ARRAY)
 
 	def step_and_draw(dt):
 		import time
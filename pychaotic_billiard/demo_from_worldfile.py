@@ -1,8 +1,12 @@
 import json
-from physics import World, Segment, Arc, BezierCubic, Ball, vec2
+import os
+import tempfile
+import numpy as np
+from physics import World, Segment, Arc, BezierCubic, Ball, vec2, worldfile
+from physics import LineGenerator, FanGenerator, GridGenerator, UniformGenerator
 from typing import Union
 
-def from_dict(j: dict) -> Union[Segment, Arc, BezierCubic, Ball, vec2]:
+def from_dict(j: dict) -> Union[Segment, Arc, BezierCubic, Ball, vec2, LineGenerator, FanGenerator, GridGenerator, UniformGenerator]:
 	if j["class"] == "vec2":
 		return vec2(j["parameters"]["x"], j["parameters"]["y"])
 	elif j["class"] == "Ball":
@@ -13,17 +17,47 @@ def from_dict(j: dict) -> Union[Segment, Arc, BezierCubic, Ball, vec2]:
 		return Arc(from_dict(j["parameters"]["p0"]), j["parameters"]["r"], j["parameters"]["theta_min"], j["parameters"]["theta_max"])
 	elif j["class"] == "BezierCubic":
 		return BezierCubic(from_dict(j["parameters"]["p0"]), from_dict(j["parameters"]["p1"]), from_dict(j["parameters"]["p2"]), from_dict(j["parameters"]["p3"]))
+	elif j["class"] == "LineGenerator":
+		return LineGenerator(from_dict(j["parameters"]["p1"]), from_dict(j["parameters"]["p2"]), from_dict(j["parameters"]["vel"]), j["parameters"]["n"])
+	elif j["class"] == "FanGenerator":
+		return FanGenerator(from_dict(j["parameters"]["p0"]), j["parameters"]["angle_min"], j["parameters"]["angle_max"], j["parameters"]["speed"], j["parameters"]["n"])
+	elif j["class"] == "GridGenerator":
+		return GridGenerator(from_dict(j["parameters"]["pmin"]), from_dict(j["parameters"]["pmax"]), from_dict(j["parameters"]["vel"]), j["parameters"]["nx"], j["parameters"]["ny"])
+	elif j["class"] == "UniformGenerator":
+		return UniformGenerator(from_dict(j["parameters"]["pmin"]), from_dict(j["parameters"]["pmax"]), j["parameters"]["speed"], j["parameters"]["n"], j["parameters"].get("seed", 0))
 	else:
 		raise RuntimeError(f'unkown class {j["class"]}')
 
 def world_from_dict(j: dict) -> World:
 	world = World()
+	xy = lambda j_vec2: (j_vec2['parameters']['x'], j_vec2['parameters']['y'])
 
-	for j_ball in j['balls']:
-		world.add_ball(from_dict(j_ball))
-	
+	# the explicit balls are copied into the World in one call
+	j_balls = j.get('balls', [])
+	if j_balls:
+		pos = np.array([xy(j_ball['parameters']['pos']) for j_ball in j_balls])
+		vel = np.array([xy(j_ball['parameters']['vel']) for j_ball in j_balls])
+		world.add_balls(pos, vel)
+
+	# generated balls come after the explicit ones
+	for j_generator in j.get('generators', []):
+		world.add_balls(from_dict(j_generator))
+
+	# runs of segments are added in one call, the order of the curves is kept
+	p1, p2 = [], []
+	def flush_segments():
+		if p1:
+			world.add_segments(np.array(p1), np.array(p2))
+			p1.clear()
+			p2.clear()
 	for j_curve in j['curves']:
-		world.add_curve(from_dict(j_curve))
+		if j_curve['class'] == 'Segment':
+			p1.append(xy(j_curve['parameters']['p1']))
+			p2.append(xy(j_curve['parameters']['p2']))
+		else:
+			flush_segments()
+			world.add_curve(from_dict(j_curve))
+	flush_segments()
 
 	return world
 
@@ -36,5 +70,15 @@ if __name__ == '__main__':
 	print(world)
 
 	print('>>> re-serializing and asserting equality')
-	assert world_json == json.loads(world.json())
+	# the generators are expanded, the re-serialized world lists all the balls
+	assert world_json['curves'] == json.loads(world.json())['curves']
+	assert world.json() == world_from_dict(json.loads(world.json())).json()
+	print('OK')
+
+	print('>>> round trip through the binary world format')
+	with tempfile.TemporaryDirectory() as tmp:
+		path = os.path.join(tmp, 'world_circle3.cbw')
+		worldfile.save(world, path)
+		assert worldfile.is_world_file(path)
+		assert world.json() == worldfile.load(path).json()
 	print('OK')
\ No newline at end of file
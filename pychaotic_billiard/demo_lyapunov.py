@@ -17,13 +17,8 @@ world.add_ball(Ball(vec2(350, 250), vec2(np.cos(angle0+delta0/2), np.sin(angle0+
 
 print('>>> running simulation')
 nsteps = 100_000
-nballs = len(world.balls)
-pos = np.empty((nsteps, nballs, 2))
-for i in range(nsteps):
-	world.step(0.2)
-	for j in range(nballs):
-		pos[i, j, 0] = world.get_ball(j).pos.x
-		pos[i, j, 1] = world.get_ball(j).pos.y
+# the whole loop runs in C++, the positions after every step are returned as a (nsteps, nballs, 2) array
+pos = world.run(nsteps, 0.2, fields=('positions',))['positions']
 
 print('>>> plotting')
 fig, ax = plt.subplots(tight_layout=True)
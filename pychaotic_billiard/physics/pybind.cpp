@@ -5,13 +5,27 @@
 #include <pybind11/smart_holder.h>
 #include <pybind11/operators.h>
 #include <pybind11/stl.h>
+#include <pybind11/numpy.h>
+
+#include <atomic>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
+#include <utility>  // std::pair
 
 #include "physics/globals.h"
 #include "physics/logger.hpp"
 #include "physics/vec2.hpp"
 #include "physics/ball.hpp"
+#include "physics/ball_generator.hpp"
 #include "physics/curve.hpp"
 #include "physics/world.hpp"
+#include "physics/events.hpp"
+#include "physics/statistics.hpp"
+#include "physics/trajectory.hpp"
+#include "physics/density.hpp"
+#include "physics/generator.hpp"
+#include "physics/worldfile.hpp"
 
 namespace py = pybind11;
 
@@ -31,7 +45,7 @@ class PyCurve : public Curve, public py::trampoline_self_life_support {
 public:
 	using Curve::Curve;
 
-	virtual vec2 operator()(double t, unsigned int order = 0) const override { PYBIND11_OVERRIDE_PURE(vec2, Curve, operator(), t, order); }
+	virtual vec2 operator()(double t, unsigned int order = 0) const override { PYBIND11_OVERRIDE_PURE_NAME(vec2, Curve, "__call__", operator(), t, order); }
 	virtual double inverse(vec2 const& point) const override { PYBIND11_OVERRIDE_PURE(double, Curve, inverse, point); }
 	virtual vec2 ortho(double t) const override { PYBIND11_OVERRIDE_PURE(vec2, Curve, ortho, t); }
 	virtual vec2 tangent(double t) const override { PYBIND11_OVERRIDE_PURE(vec2, Curve, tangent, t); }
@@ -45,73 +59,232 @@ public:
 	virtual std::string json() const override { PYBIND11_OVERRIDE_PURE(std::string, Curve, json); }
 };
 
-class PyLine : public Line, public py::trampoline_self_life_support {
+// Dispatch of the hot functions of the trampolines of the C++ curves
+// Looking an override up takes the GIL, on every call of the step loop. The overrides of a curve are instead looked up
+// once, when it is added to a World, and the functions its Python class does not override then run the C++
+// implementation directly. Curves that have not been added to a World look the overrides up on every call.
+// The lookup is py::get_override, as in PYBIND11_OVERRIDE: a function is native when the attribute found on the object
+// is the bound C++ function. Like pybind11's own cache of inactive overrides, methods assigned to the class after the
+// curve is added are not seen. add_curve finds the dispatch by a cross-cast from Curve, its second polymorphic base.
+class PyCurveDispatch {
+public:
+	enum Function : unsigned int { CALL = 1, INVERSE = 2, ORTHO = 4, TANGENT = 8, COLLIDE = 16 };
+
+	PyCurveDispatch() = default;
+	// a copy is a new Python object, its class is only known once it is added
+	PyCurveDispatch(PyCurveDispatch const&) {}
+	PyCurveDispatch& operator=(PyCurveDispatch const&) { return *this; }
+	virtual ~PyCurveDispatch() = default;
+
+	// looks the overrides up, requires the GIL
+	virtual void resolve() = 0;
+
+	// "native", or "python" followed by the overridden functions
+	std::string path() const {
+		unsigned int found(state.load(std::memory_order_relaxed));
+		if (!(found & RESOLVED))
+			return "python";
+		std::string overridden;
+		for (auto const& [function, name] : NAMES)
+			if (found & function)
+				overridden += (overridden.empty() ? "" : ", ") + std::string(name);
+		return overridden.empty() ? "native" : "python (" + overridden + ")";
+	}
+
+protected:
+	template <typename T>
+	void resolve_overrides(T const* self) {
+		unsigned int found(RESOLVED);
+		for (auto const& [function, name] : NAMES)
+			if (py::get_override(self, name))
+				found |= function;
+		state.store(found, std::memory_order_relaxed);
+	}
+
+	bool native(Function function) const {
+		unsigned int found(state.load(std::memory_order_relaxed));
+		return (found & RESOLVED) && !(found & function);
+	}
+
+private:
+	static constexpr unsigned int RESOLVED = 1u << 31;
+	static constexpr std::pair<Function, char const*> NAMES[] = {
+		{CALL, "__call__"}, {INVERSE, "inverse"}, {ORTHO, "ortho"}, {TANGENT, "tangent"}, {COLLIDE, "collide"}};
+
+	std::atomic<unsigned int> state{0};  // RESOLVED | overridden functions
+};
+
+class PyLine : public Line, public PyCurveDispatch, public py::trampoline_self_life_support {
 public:
 	using Line::Line;
 
-	virtual vec2 operator()(double t, unsigned int order = 0) const override { PYBIND11_OVERRIDE(vec2, Line, operator(), t, order); }
-	virtual double inverse(vec2 const& point) const override { PYBIND11_OVERRIDE(double, Line, inverse, point); }
-	virtual vec2 ortho(double t) const override { PYBIND11_OVERRIDE(vec2, Line, ortho, t); }
-	virtual vec2 tangent(double t) const override { PYBIND11_OVERRIDE(vec2, Line, tangent, t); }
+	virtual void resolve() override { resolve_overrides(static_cast<Line const*>(this)); }
+
+	virtual vec2 operator()(double t, unsigned int order = 0) const override {
+		if (native(CALL)) return Line::operator()(t, order);
+		PYBIND11_OVERRIDE_NAME(vec2, Line, "__call__", operator(), t, order);
+	}
+	virtual double inverse(vec2 const& point) const override {
+		if (native(INVERSE)) return Line::inverse(point);
+		PYBIND11_OVERRIDE(double, Line, inverse, point);
+	}
+	virtual vec2 ortho(double t) const override {
+		if (native(ORTHO)) return Line::ortho(t);
+		PYBIND11_OVERRIDE(vec2, Line, ortho, t);
+	}
+	virtual vec2 tangent(double t) const override {
+		if (native(TANGENT)) return Line::tangent(t);
+		PYBIND11_OVERRIDE(vec2, Line, tangent, t);
+	}
 
-	virtual Collider::ParamPairs collide(Line const& line) const override { PYBIND11_OVERRIDE(Collider::ParamPairs, Line, collide, line); }
-	virtual Collider::ParamPairs collide(Segment const& seg) const override { PYBIND11_OVERRIDE(Collider::ParamPairs, Line, collide, seg); }
-	virtual Collider::ParamPairs collide(Arc const& arc) const override { PYBIND11_OVERRIDE(Collider::ParamPairs, Line, collide, arc); }
-	virtual Collider::ParamPairs collide(BezierCubic const& bezier) const override { PYBIND11_OVERRIDE(Collider::ParamPairs, Line, collide, bezier); }
+	virtual Collider::ParamPairs collide(Line const& line) const override {
+		if (native(COLLIDE)) return Line::collide(line);
+		PYBIND11_OVERRIDE(Collider::ParamPairs, Line, collide, line);
+	}
+	virtual Collider::ParamPairs collide(Segment const& seg) const override {
+		if (native(COLLIDE)) return Line::collide(seg);
+		PYBIND11_OVERRIDE(Collider::ParamPairs, Line, collide, seg);
+	}
+	virtual Collider::ParamPairs collide(Arc const& arc) const override {
+		if (native(COLLIDE)) return Line::collide(arc);
+		PYBIND11_OVERRIDE(Collider::ParamPairs, Line, collide, arc);
+	}
+	virtual Collider::ParamPairs collide(BezierCubic const& bezier) const override {
+		if (native(COLLIDE)) return Line::collide(bezier);
+		PYBIND11_OVERRIDE(Collider::ParamPairs, Line, collide, bezier);
+	}
 
 	virtual std::string str() const override { PYBIND11_OVERRIDE(std::string, Line, str); }
 	virtual std::string json() const override { PYBIND11_OVERRIDE(std::string, Line, json); }
 };
 
-class PySegment : public Segment, public py::trampoline_self_life_support {
+class PySegment : public Segment, public PyCurveDispatch, public py::trampoline_self_life_support {
 public:
 	using Segment::Segment;
 
-	virtual vec2 operator()(double t, unsigned int order = 0) const override { PYBIND11_OVERRIDE(vec2, Segment, operator(), t, order); }
-	virtual double inverse(vec2 const& point) const override { PYBIND11_OVERRIDE(double, Segment, inverse, point); }
-	virtual vec2 ortho(double t) const override { PYBIND11_OVERRIDE(vec2, Segment, ortho, t); }
-	virtual vec2 tangent(double t) const override { PYBIND11_OVERRIDE(vec2, Segment, tangent, t); }
+	virtual void resolve() override { resolve_overrides(static_cast<Segment const*>(this)); }
+
+	virtual vec2 operator()(double t, unsigned int order = 0) const override {
+		if (native(CALL)) return Segment::operator()(t, order);
+		PYBIND11_OVERRIDE_NAME(vec2, Segment, "__call__", operator(), t, order);
+	}
+	virtual double inverse(vec2 const& point) const override {
+		if (native(INVERSE)) return Segment::inverse(point);
+		PYBIND11_OVERRIDE(double, Segment, inverse, point);
+	}
+	virtual vec2 ortho(double t) const override {
+		if (native(ORTHO)) return Segment::ortho(t);
+		PYBIND11_OVERRIDE(vec2, Segment, ortho, t);
+	}
+	virtual vec2 tangent(double t) const override {
+		if (native(TANGENT)) return Segment::tangent(t);
+		PYBIND11_OVERRIDE(vec2, Segment, tangent, t);
+	}
 
-	virtual Collider::ParamPairs collide(Line const& line) const override { PYBIND11_OVERRIDE(Collider::ParamPairs, Segment, collide, line); }
-	virtual Collider::ParamPairs collide(Segment const& seg) const override { PYBIND11_OVERRIDE(Collider::ParamPairs, Segment, collide, seg); }
-	virtual Collider::ParamPairs collide(Arc const& arc) const override { PYBIND11_OVERRIDE(Collider::ParamPairs, Segment, collide, arc); }
-	virtual Collider::ParamPairs collide(BezierCubic const& bezier) const override { PYBIND11_OVERRIDE(Collider::ParamPairs, Segment, collide, bezier); }
+	virtual Collider::ParamPairs collide(Line const& line) const override {
+		if (native(COLLIDE)) return Segment::collide(line);
+		PYBIND11_OVERRIDE(Collider::ParamPairs, Segment, collide, line);
+	}
+	virtual Collider::ParamPairs collide(Segment const& seg) const override {
+		if (native(COLLIDE)) return Segment::collide(seg);
+		PYBIND11_OVERRIDE(Collider::ParamPairs, Segment, collide, seg);
+	}
+	virtual Collider::ParamPairs collide(Arc const& arc) const override {
+		if (native(COLLIDE)) return Segment::collide(arc);
+		PYBIND11_OVERRIDE(Collider::ParamPairs, Segment, collide, arc);
+	}
+	virtual Collider::ParamPairs collide(BezierCubic const& bezier) const override {
+		if (native(COLLIDE)) return Segment::collide(bezier);
+		PYBIND11_OVERRIDE(Collider::ParamPairs, Segment, collide, bezier);
+	}
 
 	virtual std::string str() const override { PYBIND11_OVERRIDE(std::string, Segment, str); }
 	virtual std::string json() const override { PYBIND11_OVERRIDE(std::string, Segment, json); }
 };
 
-class PyArc : public Arc, public py::trampoline_self_life_support {
+class PyArc : public Arc, public PyCurveDispatch, public py::trampoline_self_life_support {
 public:
 	using Arc::Arc;
 
-	virtual vec2 operator()(double t, unsigned int order = 0) const override { PYBIND11_OVERRIDE(vec2, Arc, operator(), t, order); }
-	virtual double inverse(vec2 const& point) const override { PYBIND11_OVERRIDE(double, Arc, inverse, point); }
-	virtual vec2 ortho(double t) const override { PYBIND11_OVERRIDE(vec2, Arc, ortho, t); }
-	virtual vec2 tangent(double t) const override { PYBIND11_OVERRIDE(vec2, Arc, tangent, t); }
+	virtual void resolve() override { resolve_overrides(static_cast<Arc const*>(this)); }
 
-	virtual Collider::ParamPairs collide(Line const& line) const override { PYBIND11_OVERRIDE(Collider::ParamPairs, Arc, collide, line); }
-	virtual Collider::ParamPairs collide(Segment const& seg) const override { PYBIND11_OVERRIDE(Collider::ParamPairs, Arc, collide, seg); }
-	virtual Collider::ParamPairs collide(Arc const& arc) const override { PYBIND11_OVERRIDE(Collider::ParamPairs, Arc, collide, arc); }
-	virtual Collider::ParamPairs collide(BezierCubic const& bezier) const override { PYBIND11_OVERRIDE(Collider::ParamPairs, Arc, collide, bezier); }
+	virtual vec2 operator()(double t, unsigned int order = 0) const override {
+		if (native(CALL)) return Arc::operator()(t, order);
+		PYBIND11_OVERRIDE_NAME(vec2, Arc, "__call__", operator(), t, order);
+	}
+	virtual double inverse(vec2 const& point) const override {
+		if (native(INVERSE)) return Arc::inverse(point);
+		PYBIND11_OVERRIDE(double, Arc, inverse, point);
+	}
+	virtual vec2 ortho(double t) const override {
+		if (native(ORTHO)) return Arc::ortho(t);
+		PYBIND11_OVERRIDE(vec2, Arc, ortho, t);
+	}
+	virtual vec2 tangent(double t) const override {
+		if (native(TANGENT)) return Arc::tangent(t);
+		PYBIND11_OVERRIDE(vec2, Arc, tangent, t);
+	}
+
+	virtual Collider::ParamPairs collide(Line const& line) const override {
+		if (native(COLLIDE)) return Arc::collide(line);
+		PYBIND11_OVERRIDE(Collider::ParamPairs, Arc, collide, line);
+	}
+	virtual Collider::ParamPairs collide(Segment const& seg) const override {
+		if (native(COLLIDE)) return Arc::collide(seg);
+		PYBIND11_OVERRIDE(Collider::ParamPairs, Arc, collide, seg);
+	}
+	virtual Collider::ParamPairs collide(Arc const& arc) const override {
+		if (native(COLLIDE)) return Arc::collide(arc);
+		PYBIND11_OVERRIDE(Collider::ParamPairs, Arc, collide, arc);
+	}
+	virtual Collider::ParamPairs collide(BezierCubic const& bezier) const override {
+		if (native(COLLIDE)) return Arc::collide(bezier);
+		PYBIND11_OVERRIDE(Collider::ParamPairs, Arc, collide, bezier);
+	}
 
 	virtual std::string str() const override { PYBIND11_OVERRIDE(std::string, Arc, str); }
 	virtual std::string json() const override { PYBIND11_OVERRIDE(std::string, Arc, json); }
 };
 
-class PyBezierCubic : public BezierCubic, public py::trampoline_self_life_support {
+class PyBezierCubic : public BezierCubic, public PyCurveDispatch, public py::trampoline_self_life_support {
 public:
 	using BezierCubic::BezierCubic;
 
-	virtual vec2 operator()(double t, unsigned int order = 0) const override { PYBIND11_OVERRIDE(vec2, BezierCubic, operator(), t, order); }
-	virtual double inverse(vec2 const& point) const override { PYBIND11_OVERRIDE(double, BezierCubic, inverse, point); }
-	virtual vec2 ortho(double t) const override { PYBIND11_OVERRIDE(vec2, BezierCubic, ortho, t); }
-	virtual vec2 tangent(double t) const override { PYBIND11_OVERRIDE(vec2, BezierCubic, tangent, t); }
+	virtual void resolve() override { resolve_overrides(static_cast<BezierCubic const*>(this)); }
+
+	virtual vec2 operator()(double t, unsigned int order = 0) const override {
+		if (native(CALL)) return BezierCubic::operator()(t, order);
+		PYBIND11_OVERRIDE_NAME(vec2, BezierCubic, "__call__", operator(), t, order);
+	}
+	virtual double inverse(vec2 const& point) const override {
+		if (native(INVERSE)) return BezierCubic::inverse(point);
+		PYBIND11_OVERRIDE(double, BezierCubic, inverse, point);
+	}
+	virtual vec2 ortho(double t) const override {
+		if (native(ORTHO)) return BezierCubic::ortho(t);
+		PYBIND11_OVERRIDE(vec2, BezierCubic, ortho, t);
+	}
+	virtual vec2 tangent(double t) const override {
+		if (native(TANGENT)) return BezierCubic::tangent(t);
+		PYBIND11_OVERRIDE(vec2, BezierCubic, tangent, t);
+	}
 
-	virtual Collider::ParamPairs collide(Line const& line) const override { PYBIND11_OVERRIDE(Collider::ParamPairs, BezierCubic, collide, line); }
-	virtual Collider::ParamPairs collide(Segment const& seg) const override { PYBIND11_OVERRIDE(Collider::ParamPairs, BezierCubic, collide, seg); }
-	virtual Collider::ParamPairs collide(Arc const& arc) const override { PYBIND11_OVERRIDE(Collider::ParamPairs, BezierCubic, collide, arc); }
-	virtual Collider::ParamPairs collide(BezierCubic const& bezier) const override { PYBIND11_OVERRIDE(Collider::ParamPairs, BezierCubic, collide, bezier); }
+	virtual Collider::ParamPairs collide(Line const& line) const override {
+		if (native(COLLIDE)) return BezierCubic::collide(line);
+		PYBIND11_OVERRIDE(Collider::ParamPairs, BezierCubic, collide, line);
+	}
+	virtual Collider::ParamPairs collide(Segment const& seg) const override {
+		if (native(COLLIDE)) return BezierCubic::collide(seg);
+		PYBIND11_OVERRIDE(Collider::ParamPairs, BezierCubic, collide, seg);
+	}
+	virtual Collider::ParamPairs collide(Arc const& arc) const override {
+		if (native(COLLIDE)) return BezierCubic::collide(arc);
+		PYBIND11_OVERRIDE(Collider::ParamPairs, BezierCubic, collide, arc);
+	}
+	virtual Collider::ParamPairs collide(BezierCubic const& bezier) const override {
+		if (native(COLLIDE)) return BezierCubic::collide(bezier);
+		PYBIND11_OVERRIDE(Collider::ParamPairs, BezierCubic, collide, bezier);
+	}
 
 	virtual std::string str() const override { PYBIND11_OVERRIDE(std::string, BezierCubic, str); }
 	virtual std::string json() const override { PYBIND11_OVERRIDE(std::string, BezierCubic, json); }
@@ -136,6 +309,347 @@ PYBIND11_SMART_HOLDER_TYPE_CASTERS(Arc)
 PYBIND11_SMART_HOLDER_TYPE_CASTERS(BezierCubic)
 PYBIND11_SMART_HOLDER_TYPE_CASTERS(Ball)
 
+// The event queue consumer thread may be waiting for the GIL inside a Python callback sink,
+// so recording must be stopped with the GIL released before the World is destroyed
+
+struct WorldDeleter {
+	void operator()(World* world) const {
+		{
+			py::gil_scoped_release release;
+			world->set_event_sink(nullptr);
+		}
+		delete world;
+	}
+};
+
+// Zero-copy numpy views of the ball columns (World.positions, World.velocities, World.prev_positions)
+// The arrays point into the C++ storage, their base keeps the World alive and counts the live views of its balls.
+// Adding balls may move the storage, so it raises BufferError while views exist, like resizing an exported bytearray.
+// The counts are only touched with the GIL held.
+
+std::unordered_map<World const*, size_t> balls_views;
+
+struct BallsView {
+	py::object owner;  // the Python World
+	World const* world;
+
+	explicit BallsView(py::object owner_) : owner(std::move(owner_)), world(owner.cast<World const*>()) { ++balls_views[world]; }
+	~BallsView() {
+		if (--balls_views[world] == 0)
+			balls_views.erase(world);
+	}
+};
+
+void check_resizable(World const& world) {
+	if (balls_views.count(&world) != 0)
+		throw py::buffer_error("cannot add balls while numpy views of them exist (World.positions, World.velocities, World.prev_positions), delete the views first");
+}
+
+// (nballs, 2) array sharing memory with `column` of the balls of the World `owner`
+py::array_t<double> balls_view(py::object owner, Column<vec2> Balls::* column) {
+	static_assert(sizeof(vec2) == 2*sizeof(double), "vec2 must be two packed doubles");
+	Column<vec2>& values(owner.cast<World&>().balls.*column);
+	py::capsule base(new BallsView(owner), [](void* view) { delete static_cast<BallsView*>(view); });
+	std::vector<py::ssize_t> shape{py::ssize_t(values.size()), 2}, strides{sizeof(vec2), sizeof(double)};
+	return py::array_t<double>(shape, strides, reinterpret_cast<double*>(values.data()), base);
+}
+
+// Bulk construction from numpy arrays of points
+// Arrays of another dtype or layout are converted by pybind11, the points are then copied straight into the World.
+
+typedef py::array_t<double, py::array::c_style | py::array::forcecast> Vec2Array;
+
+// checks that `array` has shape (n, 2) and returns n
+size_t vec2_rows(Vec2Array const& array, std::string const& name) {
+	if (array.ndim() != 2 || array.shape(1) != 2)
+		throw py::value_error("`" + name + "` must have shape (n, 2)");
+	return array.shape(0);
+}
+
+vec2 const* vec2_data(Vec2Array const& array) {
+	return reinterpret_cast<vec2 const*>(array.data());
+}
+
+void add_balls_from_arrays(World& world, Vec2Array const& pos, Vec2Array const& vel) {
+	size_t n(vec2_rows(pos, "pos"));
+	if (vec2_rows(vel, "vel") != n)
+		throw py::value_error("`pos` and `vel` must have the same number of rows");
+	check_resizable(world);
+	py::gil_scoped_release release;
+	world.balls.append(vec2_data(pos), vec2_data(vel), n);
+}
+
+// replaces the state of all the balls, the number of balls may change
+void set_balls_state(World& world, Vec2Array const& pos, Vec2Array const& vel, std::optional<Vec2Array> const& prev_positions) {
+	size_t n(vec2_rows(pos, "pos"));
+	if (vec2_rows(vel, "vel") != n || (prev_positions && vec2_rows(*prev_positions, "prev_positions") != n))
+		throw py::value_error("`pos`, `vel` and `prev_positions` must have the same number of rows");
+	bool resize(n != world.balls.size());
+	if (resize)
+		check_resizable(world);
+	vec2 const* pos_prev(prev_positions ? vec2_data(*prev_positions) : vec2_data(pos));
+	py::gil_scoped_release release;
+	// the storage only moves when the number of balls changes
+	if (resize)
+		world.balls.resize(n);
+	std::copy(vec2_data(pos), vec2_data(pos) + n, world.balls.pos.begin());
+	std::copy(vec2_data(vel), vec2_data(vel) + n, world.balls.vel.begin());
+	std::copy(pos_prev, pos_prev + n, world.balls.pos_prev.begin());
+	// these are new balls, their speed drift is measured from their new speeds
+	if (world.get_statistics())
+		world.get_statistics()->reset_references();
+}
+
+void add_segments_from_arrays(World& world, Vec2Array const& p1, Vec2Array const& p2) {
+	size_t n(vec2_rows(p1, "p1"));
+	if (vec2_rows(p2, "p2") != n)
+		throw py::value_error("`p1` and `p2` must have the same number of rows");
+	vec2 const* a(vec2_data(p1));
+	vec2 const* b(vec2_data(p2));
+	py::gil_scoped_release release;
+	world.curve_ptrs.reserve(world.curve_ptrs.size() + n);
+	for (size_t i(0); i < n; ++i)
+		world.add_curve(std::make_shared<Segment>(a[i], b[i]));
+}
+
+// Array versions of the functions of the curves, for analysis scripts
+// The loops run in C++ with the GIL released, the overrides of Python subclasses still take it back on every call.
+
+typedef py::array_t<double, py::array::c_style | py::array::forcecast> DoubleArray;
+
+// applies `f` to every parameter of `t`, into an array of shape t.shape + (2,)
+template <typename F>
+py::array_t<double> map_params(DoubleArray const& t, F const& f) {
+	std::vector<py::ssize_t> shape(t.shape(), t.shape() + t.ndim());
+	shape.push_back(2);
+	py::array_t<double> out(shape);
+	double const* params(t.data());
+	vec2* points(reinterpret_cast<vec2*>(out.mutable_data()));
+	size_t n(t.size());
+	py::gil_scoped_release release;
+	for (size_t i(0); i < n; ++i)
+		points[i] = f(params[i]);
+	return out;
+}
+
+py::array_t<double> curve_eval(Curve const& curve, DoubleArray const& t, unsigned int order) {
+	return map_params(t, [&](double ti) { return curve(ti, order); });
+}
+
+// ortho and tangent of a parameter, or of an array of parameters of any dtype
+// (as two overloads, an array of size 1 that is not float64 would bind to the scalar one through its float conversion)
+template <vec2 (Curve::*function)(double) const>
+py::object curve_params(Curve const& curve, py::object const& t) {
+	if (!py::isinstance<py::array>(t))
+		return py::cast((curve.*function)(t.cast<double>()));
+	return map_params(t.cast<DoubleArray>(), [&](double ti) { return (curve.*function)(ti); });
+}
+
+py::array_t<double> curve_inverse(Curve const& curve, Vec2Array const& points) {
+	size_t n(vec2_rows(points, "points"));
+	py::array_t<double> out(py::ssize_t(n));
+	vec2 const* in(vec2_data(points));
+	double* params(out.mutable_data());
+	py::gil_scoped_release release;
+	for (size_t i(0); i < n; ++i)
+		params[i] = curve.inverse(in[i]);
+	return out;
+}
+
+// intersections of the curve with each of the (n, 2, 2) `segments` (endpoints p1, p2)
+// returns the arrays (index of the segment, parameter on the curve, parameter on the segment), one row per intersection,
+// unfiltered like Curve.collide (the parameters may fall outside of [0, 1])
+py::tuple curve_collide_segments(Curve const& curve, DoubleArray const& segments) {
+	if (segments.ndim() != 3 || segments.shape(1) != 2 || segments.shape(2) != 2)
+		throw py::value_error("`segments` must have shape (n, 2, 2)");
+	size_t n(segments.shape(0));
+	vec2 const* ends(reinterpret_cast<vec2 const*>(segments.data()));
+	std::vector<int64_t> index;
+	std::vector<double> t_curve, t_segment;
+	{
+		py::gil_scoped_release release;
+		for (size_t i(0); i < n; ++i) {
+			for (Collider::ParamPair const& tpair : curve.collide(Segment(ends[2*i], ends[2*i + 1]))) {
+				index.push_back(i);
+				t_curve.push_back(tpair.t1);
+				t_segment.push_back(tpair.t2);
+			}
+		}
+	}
+	return py::make_tuple(
+		py::array_t<int64_t>(py::ssize_t(index.size()), index.data()),
+		py::array_t<double>(py::ssize_t(t_curve.size()), t_curve.data()),
+		py::array_t<double>(py::ssize_t(t_segment.size()), t_segment.data()));
+}
+
+// adds ortho, tangent and the array versions of the functions of a curve class, its scalar versions of inverse and
+// collide must already be defined
+// (Python only looks the overloads of a name up in the first class of the MRO that defines it)
+template <typename Class>
+void def_curve_arrays(Class& cls) {
+	cls.def("eval", &curve_eval, py::arg("t"), py::arg("order") = 0)
+		.def("ortho", &curve_params<&Curve::ortho>, py::arg("t"))
+		.def("tangent", &curve_params<&Curve::tangent>, py::arg("t"))
+		.def("inverse", &curve_inverse, py::arg("points"))
+		.def("collide", &curve_collide_segments, py::arg("segments"));
+}
+
+// World.add_curve: the overrides of the trampolines are looked up now, while the GIL is held
+void add_curve(World& world, std::shared_ptr<Curve> const& curve) {
+	if (auto dispatch = dynamic_cast<PyCurveDispatch*>(curve.get()))
+		dispatch->resolve();
+	world.add_curve(curve);
+}
+
+// how the step loop calls the functions of `curve` (see PyCurveDispatch)
+std::string curve_path(Curve const& curve) {
+	if (auto dispatch = dynamic_cast<PyCurveDispatch const*>(&curve))
+		return dispatch->path();
+	if (dynamic_cast<PyCurve const*>(&curve))
+		return "python";  // subclass of Curve, there is no C++ implementation
+	return "native";
+}
+
+// World pickling: the state is the binary world file of the World (see WorldFile), and its thread count
+// The attachments (event sink, statistics, trajectory, density) are not pickled, and Python subclasses of the curves
+// are pickled as their C++ class.
+
+py::tuple world_getstate(World const& world) {
+	size_t size(WorldFile::encoded_size(world));
+	py::bytes image(py::reinterpret_steal<py::bytes>(PyBytes_FromStringAndSize(nullptr, size)));
+	if (!image)
+		throw py::error_already_set();
+	char* out(PyBytes_AS_STRING(image.ptr()));
+	{
+		py::gil_scoped_release release;
+		WorldFile::encode(world, out);
+	}
+	return py::make_tuple(image, world.get_nthreads());
+}
+
+World world_setstate(py::tuple const& state) {
+	if (state.size() != 2)
+		throw std::runtime_error("invalid World state");
+	std::string_view image(state[0].cast<std::string_view>());
+	unsigned int nthreads(state[1].cast<unsigned int>());
+	py::gil_scoped_release release;
+	World world(WorldFile::decode(image.data(), image.size()));
+	world.set_nthreads(nthreads);
+	return world;
+}
+
+// a new multiprocessing.shared_memory.SharedMemory block holding the world file of `world`
+// Worker processes attach to it by name with worldfile.load_shared, the owner closes and unlinks it
+py::object world_to_shared_memory(World const& world) {
+	size_t size(WorldFile::encoded_size(world));
+	py::object shm(py::module_::import("multiprocessing.shared_memory").attr("SharedMemory")(py::arg("create") = true, py::arg("size") = size));
+	try {
+		py::buffer_info buf(py::buffer(shm.attr("buf")).request(true));
+		if (size_t(buf.size) < size)
+			throw std::runtime_error("shared memory block too small");
+		py::gil_scoped_release release;
+		WorldFile::encode(world, buf.ptr);
+	} catch (...) {
+		shm.attr("close")();
+		shm.attr("unlink")();
+		throw;
+	}
+	return shm;
+}
+
+// World.run: steps the World `nsteps` times in C++ with the GIL released, recording the requested `fields`
+// of every `record_every`-th step into preallocated arrays. The GIL is taken back every RUN_SIGNAL_STEPS steps
+// to check for signals, so that a long run can be interrupted.
+
+constexpr size_t RUN_SIGNAL_STEPS = 1024;
+
+py::dict run_world(World& world, size_t nsteps, double dt, size_t record_every, std::vector<std::string> const& fields) {
+	bool record_time(false), record_pos(false), record_vel(false);
+	for (std::string const& field : fields) {
+		if (field == "time")
+			record_time = true;
+		else if (field == "positions")
+			record_pos = true;
+		else if (field == "velocities")
+			record_vel = true;
+		else
+			throw py::value_error("unknown field `" + field + "`, expected `time`, `positions` or `velocities`");
+	}
+	size_t nballs(world.balls.size());
+	size_t nrecords(record_every == 0 ? 0 : nsteps / record_every);
+	std::vector<py::ssize_t> shape{py::ssize_t(nrecords), py::ssize_t(nballs), 2};
+	py::dict records;
+	double* times(nullptr);
+	vec2* pos(nullptr);
+	vec2* vel(nullptr);
+	if (record_time) {
+		py::array_t<double> array(py::ssize_t(nrecords));
+		times = array.mutable_data();
+		records["time"] = array;
+	}
+	if (record_pos) {
+		py::array_t<double> array(shape);
+		pos = reinterpret_cast<vec2*>(array.mutable_data());
+		records["positions"] = array;
+	}
+	if (record_vel) {
+		py::array_t<double> array(shape);
+		vel = reinterpret_cast<vec2*>(array.mutable_data());
+		records["velocities"] = array;
+	}
+
+	py::gil_scoped_release release;
+	size_t record(0);
+	for (size_t step(1); step <= nsteps; ++step) {
+		world.step(dt);
+		if (record_every != 0 && step % record_every == 0) {
+			if (times)
+				times[record] = world.time;
+			if (pos)
+				std::copy(world.balls.pos.begin(), world.balls.pos.end(), pos + record*nballs);
+			if (vel)
+				std::copy(world.balls.vel.begin(), world.balls.vel.end(), vel + record*nballs);
+			++record;
+		}
+		if (step % RUN_SIGNAL_STEPS == 0) {
+			py::gil_scoped_acquire acquire;
+			if (PyErr_CheckSignals() != 0)
+				throw py::error_already_set();
+		}
+	}
+	return records;
+}
+
+// Python iterator over a World generator
+// The World is stepped with the GIL released each time the next element is pulled
+
+template <typename T>
+class PyGenerator {
+	Generator<T> gen;
+	typename Generator<T>::iterator it;
+	bool started = false;
+
+public:
+	explicit PyGenerator(Generator<T>&& gen) : gen(std::move(gen)) {}
+
+	T const& next() {
+		if (started && it == std::default_sentinel)
+			throw py::stop_iteration();
+		{
+			py::gil_scoped_release release;
+			if (!started) {
+				it = gen.begin();
+				started = true;
+			} else {
+				++it;
+			}
+		}
+		if (it == std::default_sentinel)
+			throw py::stop_iteration();
+		return *it;
+	}
+};
+
 // Binding code
 
 PYBIND11_MODULE(physics, m) {
@@ -189,9 +703,8 @@ PYBIND11_MODULE(physics, m) {
 		.def("__repr__", &Ball::str)
 		.def("json", &Ball::json);
 
-	py::classh<Curve, PyCurve>(m, "Curve")
-		.def("ortho", &Curve::ortho)
-		.def("tangent", &Curve::tangent)
+	py::classh<Curve, PyCurve> curve(m, "Curve");
+	curve
 		.def("collide", static_cast<Collider::ParamPairs (Curve::*)(Line const&) const>(&Curve::collide))
 		.def("collide", static_cast<Collider::ParamPairs (Curve::*)(Segment const&) const>(&Curve::collide))
 		.def("collide", static_cast<Collider::ParamPairs (Curve::*)(Arc const&) const>(&Curve::collide))
@@ -200,16 +713,16 @@ PYBIND11_MODULE(physics, m) {
 		.def("__call__", &Curve::operator(), py::arg("t"), py::arg("order") = 0)
 		.def("__repr__", &Curve::str)
 		.def("json", &Curve::json);
+	def_curve_arrays(curve);
 
-	py::classh<Line, PyLine, Curve>(m, "Line")
+	py::classh<Line, PyLine, Curve> line(m, "Line");
+	line
 		.def_readwrite("p", &Line::p)
 		.def_readwrite("q", &Line::q)
 		.def_readwrite("r", &Line::r)
 		.def(py::init<>())
 		.def(py::init<double, double, double>())
 		.def(py::init<PyLine const&>())
-		.def("ortho", &Line::ortho)
-		.def("tangent", &Line::tangent)
 		.def("collide", static_cast<Collider::ParamPairs (Line::*)(Line const&) const>(&Line::collide))
 		.def("collide", static_cast<Collider::ParamPairs (Line::*)(Segment const&) const>(&Line::collide))
 		.def("collide", static_cast<Collider::ParamPairs (Line::*)(Arc const&) const>(&Line::collide))
@@ -219,15 +732,15 @@ PYBIND11_MODULE(physics, m) {
 		.def("__call__", &Line::operator(), py::arg("t"), py::arg("order") = 0)
 		.def("__repr__", &Line::str)
 		.def("json", &Line::json);
+	def_curve_arrays(line);
 
-	py::classh<Segment, PySegment, Curve>(m, "Segment")
+	py::classh<Segment, PySegment, Curve> segment(m, "Segment");
+	segment
 		.def_readwrite("p1", &Segment::p1)
 		.def_readwrite("p2", &Segment::p2)
 		.def(py::init<>())
 		.def(py::init<vec2 const&, vec2 const&>())
 		.def(py::init<PySegment const&>())
-		.def("ortho", &Segment::ortho)
-		.def("tangent", &Segment::tangent)
 		.def("collide", static_cast<Collider::ParamPairs (Segment::*)(Line const&) const>(&Segment::collide))
 		.def("collide", static_cast<Collider::ParamPairs (Segment::*)(Segment const&) const>(&Segment::collide))
 		.def("collide", static_cast<Collider::ParamPairs (Segment::*)(Arc const&) const>(&Segment::collide))
@@ -237,8 +750,10 @@ PYBIND11_MODULE(physics, m) {
 		.def("__call__", &Segment::operator(), py::arg("t"), py::arg("order") = 0)
 		.def("__repr__", &Segment::str)
 		.def("json", &Segment::json);
+	def_curve_arrays(segment);
 
-	py::classh<Arc, PyArc, Curve>(m, "Arc")
+	py::classh<Arc, PyArc, Curve> arc(m, "Arc");
+	arc
 		.def_readwrite("p0", &Arc::p0)
 		.def_readwrite("r", &Arc::r)
 		.def_readwrite("theta_min", &Arc::theta_min)
@@ -246,8 +761,6 @@ PYBIND11_MODULE(physics, m) {
 		.def(py::init<>())
 		.def(py::init<vec2 const&, double, double, double>())
 		.def(py::init<PyArc const&>())
-		.def("ortho", &Arc::ortho)
-		.def("tangent", &Arc::tangent)
 		.def("collide", static_cast<Collider::ParamPairs (Arc::*)(Line const&) const>(&Arc::collide))
 		.def("collide", static_cast<Collider::ParamPairs (Arc::*)(Segment const&) const>(&Arc::collide))
 		.def("collide", static_cast<Collider::ParamPairs (Arc::*)(Arc const&) const>(&Arc::collide))
@@ -256,8 +769,10 @@ PYBIND11_MODULE(physics, m) {
 		.def("__call__", &Arc::operator(), py::arg("t"), py::arg("order") = 0)
 		.def("__repr__", &Arc::str)
 		.def("json", &Arc::json);
+	def_curve_arrays(arc);
 
-	py::classh<BezierCubic, PyBezierCubic, Curve>(m, "BezierCubic")
+	py::classh<BezierCubic, PyBezierCubic, Curve> bezier(m, "BezierCubic");
+	bezier
 		.def_readwrite("p1", &BezierCubic::p0)
 		.def_readwrite("p1", &BezierCubic::p1)
 		.def_readwrite("p2", &BezierCubic::p2)
@@ -265,8 +780,6 @@ PYBIND11_MODULE(physics, m) {
 		.def(py::init<>())
 		.def(py::init<vec2 const&, vec2 const&, vec2 const&, vec2 const&>())
 		.def(py::init<PyBezierCubic const&>())
-		.def("ortho", &BezierCubic::ortho)
-		.def("tangent", &BezierCubic::tangent)
 		.def("collide", static_cast<Collider::ParamPairs (BezierCubic::*)(Line const&) const>(&BezierCubic::collide))
 		.def("collide", static_cast<Collider::ParamPairs (BezierCubic::*)(Segment const&) const>(&BezierCubic::collide))
 		.def("collide", static_cast<Collider::ParamPairs (BezierCubic::*)(Arc const&) const>(&BezierCubic::collide))
@@ -275,17 +788,120 @@ PYBIND11_MODULE(physics, m) {
 		.def("__call__", &BezierCubic::operator(), py::arg("t"), py::arg("order") = 0)
 		.def("__repr__", &BezierCubic::str)
 		.def("json", &BezierCubic::json);
+	def_curve_arrays(bezier);
+
+	py::class_<BallGenerator>(m, "BallGenerator")
+		.def("__len__", &BallGenerator::size)
+		.def("__repr__", &BallGenerator::str)
+		.def("json", &BallGenerator::json);
+
+	py::class_<LineGenerator, BallGenerator>(m, "LineGenerator")
+		.def_readwrite("p1", &LineGenerator::p1)
+		.def_readwrite("p2", &LineGenerator::p2)
+		.def_readwrite("vel", &LineGenerator::vel)
+		.def_readwrite("n", &LineGenerator::n)
+		.def(py::init<vec2 const&, vec2 const&, vec2 const&, size_t>(), py::arg("p1"), py::arg("p2"), py::arg("vel"), py::arg("n"));
+
+	py::class_<FanGenerator, BallGenerator>(m, "FanGenerator")
+		.def_readwrite("p0", &FanGenerator::p0)
+		.def_readwrite("angle_min", &FanGenerator::angle_min)
+		.def_readwrite("angle_max", &FanGenerator::angle_max)
+		.def_readwrite("speed", &FanGenerator::speed)
+		.def_readwrite("n", &FanGenerator::n)
+		.def(py::init<vec2 const&, double, double, double, size_t>(), py::arg("p0"), py::arg("angle_min"), py::arg("angle_max"), py::arg("speed"), py::arg("n"));
 
-	py::class_<World>(m, "World")
+	py::class_<GridGenerator, BallGenerator>(m, "GridGenerator")
+		.def_readwrite("pmin", &GridGenerator::pmin)
+		.def_readwrite("pmax", &GridGenerator::pmax)
+		.def_readwrite("vel", &GridGenerator::vel)
+		.def_readwrite("nx", &GridGenerator::nx)
+		.def_readwrite("ny", &GridGenerator::ny)
+		.def(py::init<vec2 const&, vec2 const&, vec2 const&, size_t, size_t>(), py::arg("pmin"), py::arg("pmax"), py::arg("vel"), py::arg("nx"), py::arg("ny"));
+
+	py::class_<UniformGenerator, BallGenerator>(m, "UniformGenerator")
+		.def_readwrite("pmin", &UniformGenerator::pmin)
+		.def_readwrite("pmax", &UniformGenerator::pmax)
+		.def_readwrite("speed", &UniformGenerator::speed)
+		.def_readwrite("n", &UniformGenerator::n)
+		.def_readwrite("seed", &UniformGenerator::seed)
+		.def(py::init<vec2 const&, vec2 const&, double, size_t, uint64_t>(), py::arg("pmin"), py::arg("pmax"), py::arg("speed"), py::arg("n"), py::arg("seed") = 0);
+
+	py::class_<PyGenerator<World::Frame>>(m, "Frames")
+		.def("__iter__", [](PyGenerator<World::Frame>& gen) -> PyGenerator<World::Frame>& { return gen; }, py::return_value_policy::reference_internal)
+		.def("__next__", [](PyGenerator<World::Frame>& gen) {
+			World::Frame const& frame(gen.next());
+			return py::make_tuple(frame.index, frame.time);
+		});
+
+	py::class_<PyGenerator<Events::Bounce>>(m, "BounceEvents")
+		.def("__iter__", [](PyGenerator<Events::Bounce>& gen) -> PyGenerator<Events::Bounce>& { return gen; }, py::return_value_policy::reference_internal)
+		.def("__next__", [](PyGenerator<Events::Bounce>& gen) { return gen.next(); }, py::return_value_policy::copy);
+
+	py::class_<World, std::unique_ptr<World, WorldDeleter>>(m, "World")
 		.def(py::init<>())
-		.def("step", &World::step)
-		.def("add_ball", &World::add_ball)
-		.def("add_curve", &World::add_curve)
+		.def(py::pickle(&world_getstate, &world_setstate))
+		.def("step", &World::step, py::call_guard<py::gil_scoped_release>())
+		.def_readwrite("time", &World::time)
+		// more threads restart the event queue, whose consumer may be waiting for the GIL in a callback sink
+		.def_property("nthreads", &World::get_nthreads, [](World& world, unsigned int n) {
+			py::gil_scoped_release release;
+			world.set_nthreads(n);
+		})
+		.def("set_event_sink", &World::set_event_sink, py::arg("sink"), py::arg("settings") = Events::Settings(), py::call_guard<py::gil_scoped_release>())
+		.def("flush_events", &World::flush_events, py::call_guard<py::gil_scoped_release>())
+		.def_property_readonly("events_pushed", [](World const& world) {
+			return world.get_event_queue() ? world.get_event_queue()->pushed() : 0;
+		})
+		.def_property_readonly("events_dropped", [](World const& world) {
+			return world.get_event_queue() ? world.get_event_queue()->dropped() : 0;
+		})
+		.def_property("statistics", &World::get_statistics, &World::set_statistics)
+		.def_property("trajectory", &World::get_trajectory, &World::set_trajectory)
+		.def_property("density", &World::get_density, &World::set_density)
+		.def("frames", [](World& world, double dt, size_t n) {
+			return PyGenerator<World::Frame>(world.frames(dt, n));
+		}, py::arg("dt"), py::arg("n") = SIZE_MAX, py::keep_alive<0, 1>())
+		.def("run", &run_world, py::arg("nsteps"), py::arg("dt"), py::arg("record_every") = 1,
+			py::arg("fields") = std::vector<std::string>{"time", "positions", "velocities"})
+		.def("events", [](World& world, double dt, size_t nsteps) {
+			return PyGenerator<Events::Bounce>(world.events(dt, nsteps));
+		}, py::arg("dt"), py::arg("nsteps") = SIZE_MAX, py::keep_alive<0, 1>())
+		.def("add_ball", [](World& world, Ball const& ball) {
+			check_resizable(world);
+			world.add_ball(ball);
+		})
+		.def("add_balls", [](World& world, BallGenerator const& generator) {
+			check_resizable(world);
+			py::gil_scoped_release release;
+			world.add_balls(generator);
+		}, py::arg("generator"))
+		.def("add_balls", &add_balls_from_arrays, py::arg("pos"), py::arg("vel"))
+		.def("set_state", &set_balls_state, py::arg("pos"), py::arg("vel"), py::arg("prev_positions") = py::none())
+		.def("add_curve", &add_curve, py::arg("curve"))
+		.def("add_segments", &add_segments_from_arrays, py::arg("p1"), py::arg("p2"))
 		.def_property_readonly("balls", [](World const& world) {
-			return py::list(py::make_iterator(world.ball_ptrs.begin(), world.ball_ptrs.end()));
+			// balls are stored as contiguous arrays, these are copies
+			py::list balls;
+			for (size_t i(0); i < world.balls.size(); ++i)
+				balls.append(world.balls.get(i));
+			return balls;
 		})
+		.def_property_readonly("nballs", [](World const& world) { return world.balls.size(); })
+		// writable views, the World uses the written values from the next step on
+		.def_property_readonly("positions", [](py::object self) { return balls_view(self, &Balls::pos); })
+		.def_property_readonly("velocities", [](py::object self) { return balls_view(self, &Balls::vel); })
+		.def_property_readonly("prev_positions", [](py::object self) { return balls_view(self, &Balls::pos_prev); })
 		.def("get_ball", [](World const& world, size_t idx) {
-			return world.ball_ptrs[idx];  // much faster than generating an entire list with the balls
+			if (idx >= world.balls.size())
+				throw py::index_error("ball index `" + std::to_string(idx) + "` out of range");
+			return world.balls.get(idx);  // much faster than generating an entire list with the balls
+		})
+		.def("set_ball", [](World& world, size_t idx, Ball const& ball) {
+			if (idx >= world.balls.size())
+				throw py::index_error("ball index `" + std::to_string(idx) + "` out of range");
+			world.balls.set(idx, ball);
+			if (world.get_statistics())
+				world.get_statistics()->set_reference_speed(idx, ball.vel.length());
 		})
 		.def_property_readonly("curves", [](World const& world) {
 			return py::list(py::make_iterator(world.curve_ptrs.begin(), world.curve_ptrs.end()));
@@ -293,8 +909,16 @@ PYBIND11_MODULE(physics, m) {
 		.def("get_curve", [](World const& world, size_t idx) {
 			return world.curve_ptrs[idx];
 		})
+		// "native", or "python" followed by the functions a Python subclass overrides, for each curve
+		.def_property_readonly("curve_paths", [](World const& world) {
+			std::vector<std::string> paths;
+			for (World::CurvePtr const& curve_ptr : world.curve_ptrs)
+				paths.push_back(curve_path(*curve_ptr));
+			return paths;
+		})
 		.def("__repr__", &World::str)
-		.def("json", &World::json);
+		.def("json", &World::json)
+		.def("write_json", py::overload_cast<std::string const&>(&World::write_json, py::const_), py::arg("filepath"), py::call_guard<py::gil_scoped_release>());
 
 	py::module_ m_collider = m.def_submodule("collider", "collider utility functions");
 	py::class_<Collider::ParamPair>(m_collider, "ParamPair")
@@ -305,6 +929,193 @@ PYBIND11_MODULE(physics, m) {
 		.def("on_both", &Collider::ParamPair::on_both)
 		.def("__repr__", &Collider::ParamPair::str);
 
+	py::module_ m_events = m.def_submodule("events", "collision event recording");
+	py::class_<Events::Bounce>(m_events, "Bounce")
+		.def_readonly("ball", &Events::Bounce::ball)
+		.def_readonly("time", &Events::Bounce::time)
+		.def_readonly("curve", &Events::Bounce::curve)
+		.def_readonly("t", &Events::Bounce::t)
+		.def_readonly("pos", &Events::Bounce::pos)
+		.def_readonly("vel", &Events::Bounce::vel)
+		.def("__repr__", [](Events::Bounce const& b) {
+			return "Bounce(ball=" + std::to_string(b.ball) + ", time=" + std::to_string(b.time) + ", curve=" + std::to_string(b.curve) + ", t=" + std::to_string(b.t) + ", pos=" + b.pos.str() + ", vel=" + b.vel.str() + ")";
+		});
+	// also the layout of the records of FileSink files, np.fromfile(path, events.bounce_dtype)
+	PYBIND11_NUMPY_DTYPE(vec2, x, y);
+	PYBIND11_NUMPY_DTYPE(Events::Bounce, ball, time, curve, t, pos, vel);
+	m_events.attr("bounce_dtype") = py::dtype::of<Events::Bounce>();
+	py::enum_<Events::Overflow>(m_events, "Overflow")
+		.value("BLOCK", Events::Overflow::BLOCK)
+		.value("DROP", Events::Overflow::DROP);
+	py::class_<Events::Settings>(m_events, "Settings")
+		.def(py::init([](size_t capacity, Events::Overflow overflow, size_t batch, bool flush_every_step) {
+			return Events::Settings{capacity, overflow, batch, flush_every_step};
+		}), py::arg("capacity") = Events::Settings().capacity, py::arg("overflow") = Events::Overflow::BLOCK, py::arg("batch") = Events::Settings().batch,
+			py::arg("flush_every_step") = false)
+		.def_readwrite("capacity", &Events::Settings::capacity)
+		.def_readwrite("overflow", &Events::Settings::overflow)
+		.def_readwrite("batch", &Events::Settings::batch)
+		.def_readwrite("flush_every_step", &Events::Settings::flush_every_step);
+	py::class_<Events::Sink, std::shared_ptr<Events::Sink>>(m_events, "Sink");
+	py::class_<Events::FileSink, Events::Sink, std::shared_ptr<Events::FileSink>>(m_events, "FileSink")
+		.def(py::init<std::string const&>(), py::arg("filepath"))
+		.def_property_readonly("failed", &Events::FileSink::failed)
+		.def("close", &Events::FileSink::close, py::call_guard<py::gil_scoped_release>());
+	py::class_<Events::CallbackSink, Events::Sink, std::shared_ptr<Events::CallbackSink>>(m_events, "CallbackSink")
+		// with `arrays`, each batch is a numpy structured array of dtype `bounce_dtype` instead of a list of Bounce
+		.def(py::init([](py::function callback, size_t batch_size, bool arrays) {
+			// the callable is released with the GIL held, whichever thread drops the last reference
+			std::shared_ptr<py::function> fn(new py::function(callback), [](py::function* f) {
+				py::gil_scoped_acquire gil;
+				delete f;
+			});
+			return std::make_shared<Events::CallbackSink>([fn, arrays](std::vector<Events::Bounce> const& batch) {
+				py::gil_scoped_acquire gil;  // once per batch, on the consumer thread
+				if (arrays)
+					(*fn)(py::array_t<Events::Bounce>(py::ssize_t(batch.size()), batch.data()));
+				else
+					(*fn)(batch);
+			}, batch_size);
+		}), py::arg("callback"), py::arg("batch_size") = 1 << 12, py::arg("arrays") = false);
+	py::class_<Events::LogSink, Events::Sink, std::shared_ptr<Events::LogSink>>(m_events, "LogSink")
+		.def(py::init([](std::string const& filepath, World const& world) {
+			return std::make_shared<Events::LogSink>(filepath, world.time, world.balls);
+		}), py::arg("filepath"), py::arg("world"))
+		.def_property_readonly("failed", &Events::LogSink::failed)
+		.def("close", &Events::LogSink::close, py::call_guard<py::gil_scoped_release>());
+	py::class_<Events::Reconstructor>(m_events, "Reconstructor")
+		.def(py::init<std::string const&>(), py::arg("filepath"))
+		.def_property_readonly("nballs", &Events::Reconstructor::nballs)
+		.def_property_readonly("start_time", &Events::Reconstructor::start_time)
+		.def_property_readonly("nbounces", &Events::Reconstructor::nbounces)
+		.def("bounces", [](Events::Reconstructor const& rec, size_t ball) {
+			if (ball >= rec.nballs())
+				throw py::index_error("ball index `" + std::to_string(ball) + "` out of range");
+			std::span<Events::Bounce const> bounces(rec.bounces(ball));
+			return std::vector<Events::Bounce>(bounces.begin(), bounces.end());
+		}, py::arg("ball"))
+		.def("position", &Events::Reconstructor::position, py::arg("ball"), py::arg("time"))
+		.def("velocity", &Events::Reconstructor::velocity, py::arg("ball"), py::arg("time"))
+		.def("positions", [](Events::Reconstructor const& rec, double time) {
+			// (nballs, 2) array
+			py::array_t<double> pos(std::vector<py::ssize_t>{py::ssize_t(rec.nballs()), 2});
+			vec2* out(reinterpret_cast<vec2*>(pos.mutable_data()));
+			{
+				py::gil_scoped_release release;
+				rec.positions(time, out);
+			}
+			return pos;
+		}, py::arg("time"));
+	py::class_<Events::HistogramSink, Events::Sink, std::shared_ptr<Events::HistogramSink>>(m_events, "HistogramSink")
+		.def(py::init<size_t>(), py::arg("nbins") = 100)
+		.def_property_readonly("nbins", &Events::HistogramSink::nbins)
+		.def_property_readonly("ncurves", &Events::HistogramSink::ncurves)
+		.def("count", static_cast<uint64_t (Events::HistogramSink::*)(size_t, size_t) const>(&Events::HistogramSink::count))
+		.def("count", static_cast<uint64_t (Events::HistogramSink::*)(size_t) const>(&Events::HistogramSink::count))
+		.def("counts", &Events::HistogramSink::counts);
+
+	py::module_ m_statistics = m.def_submodule("statistics", "streaming statistics accumulated while stepping");
+	py::class_<Statistics::Settings>(m_statistics, "Settings")
+		.def(py::init([](unsigned int merge_every, double speed_tolerance, vec2 const& grid_min, vec2 const& grid_max, size_t nx, size_t ny) {
+			return Statistics::Settings{merge_every, speed_tolerance, grid_min, grid_max, nx, ny};
+		}), py::arg("merge_every") = 1, py::arg("speed_tolerance") = Statistics::Settings().speed_tolerance,
+			py::arg("grid_min") = vec2(), py::arg("grid_max") = vec2(), py::arg("nx") = 0, py::arg("ny") = 0)
+		.def_readwrite("merge_every", &Statistics::Settings::merge_every)
+		.def_readwrite("speed_tolerance", &Statistics::Settings::speed_tolerance)
+		.def_readwrite("grid_min", &Statistics::Settings::grid_min)
+		.def_readwrite("grid_max", &Statistics::Settings::grid_max)
+		.def_readwrite("nx", &Statistics::Settings::nx)
+		.def_readwrite("ny", &Statistics::Settings::ny);
+	py::class_<Statistics::Collector, std::shared_ptr<Statistics::Collector>>(m_statistics, "Collector")
+		.def(py::init<Statistics::Settings const&>(), py::arg("settings") = Statistics::Settings())
+		.def_property_readonly("settings", &Statistics::Collector::settings)
+		.def("merge", &Statistics::Collector::merge)
+		.def("reset", &Statistics::Collector::reset)
+		.def("reset_references", &Statistics::Collector::reset_references, py::arg("first") = 0)
+		.def_property_readonly("steps", &Statistics::Collector::steps)
+		.def_property_readonly("samples", &Statistics::Collector::samples)
+		.def_property_readonly("collisions", &Statistics::Collector::collisions)
+		.def_property_readonly("drift_violations", &Statistics::Collector::drift_violations)
+		.def_property_readonly("max_speed_drift", &Statistics::Collector::max_speed_drift)
+		.def_property_readonly("curve_hits", [](Statistics::Collector const& collector) {
+			std::vector<uint64_t> const& hits(collector.curve_hits());
+			return py::array_t<uint64_t>(py::ssize_t(hits.size()), hits.data());
+		})
+		.def_property_readonly("occupancy", [](Statistics::Collector const& collector) {
+			std::vector<uint64_t> const& occupancy(collector.occupancy());
+			std::vector<py::ssize_t> shape{py::ssize_t(collector.settings().ny), py::ssize_t(collector.settings().nx)};
+			return py::array_t<uint64_t>(shape, occupancy.data());
+		});
+
+	py::module_ m_density = m.def_submodule("density", "long-exposure density of the balls, accumulated while stepping");
+	py::class_<Density::Settings>(m_density, "Settings")
+		.def(py::init([](vec2 const& grid_min, vec2 const& grid_max, size_t nx, size_t ny, bool weight_by_dt) {
+			return Density::Settings{grid_min, grid_max, nx, ny, weight_by_dt};
+		}), py::arg("grid_min"), py::arg("grid_max"), py::arg("nx"), py::arg("ny"), py::arg("weight_by_dt") = false)
+		.def_readwrite("grid_min", &Density::Settings::grid_min)
+		.def_readwrite("grid_max", &Density::Settings::grid_max)
+		.def_readwrite("nx", &Density::Settings::nx)
+		.def_readwrite("ny", &Density::Settings::ny)
+		.def_readwrite("weight_by_dt", &Density::Settings::weight_by_dt);
+	py::class_<Density::Accumulator, std::shared_ptr<Density::Accumulator>>(m_density, "Accumulator")
+		.def(py::init<Density::Settings const&>(), py::arg("settings"))
+		.def_property_readonly("settings", &Density::Accumulator::settings)
+		.def("merge", &Density::Accumulator::merge)
+		.def("reset", &Density::Accumulator::reset)
+		.def_property_readonly("steps", &Density::Accumulator::steps)
+		.def_property_readonly("total", &Density::Accumulator::total)
+		.def_property_readonly("histogram", [](Density::Accumulator const& accumulator) {
+			std::vector<double> const& histogram(accumulator.histogram());
+			std::vector<py::ssize_t> shape{py::ssize_t(accumulator.settings().ny), py::ssize_t(accumulator.settings().nx)};
+			return py::array_t<double>(shape, histogram.data());
+		})
+		.def("save_npy", &Density::Accumulator::save_npy, py::arg("filepath"));
+
+	py::module_ m_trajectory = m.def_submodule("trajectory", "compressed trajectory recording");
+	py::class_<Trajectory::Settings>(m_trajectory, "Settings")
+		.def(py::init([](unsigned int every, unsigned int chunk_frames) {
+			return Trajectory::Settings{every, chunk_frames};
+		}), py::arg("every") = 1, py::arg("chunk_frames") = Trajectory::Settings().chunk_frames)
+		.def_readwrite("every", &Trajectory::Settings::every)
+		.def_readwrite("chunk_frames", &Trajectory::Settings::chunk_frames);
+	py::class_<Trajectory::Recorder, std::shared_ptr<Trajectory::Recorder>>(m_trajectory, "Recorder")
+		.def(py::init<std::string const&, Trajectory::Settings const&>(), py::arg("filepath"), py::arg("settings") = Trajectory::Settings())
+		.def_property_readonly("settings", &Trajectory::Recorder::settings)
+		.def("record", [](Trajectory::Recorder& recorder, World const& world) {
+			recorder.record(world.time, world.balls);
+		}, py::arg("world"), py::call_guard<py::gil_scoped_release>())
+		.def("close", &Trajectory::Recorder::close, py::call_guard<py::gil_scoped_release>())
+		.def_property_readonly("nframes", &Trajectory::Recorder::nframes)
+		.def_property_readonly("bytes", &Trajectory::Recorder::bytes);
+	py::class_<Trajectory::Reader>(m_trajectory, "Reader")
+		.def(py::init<std::string const&>(), py::arg("filepath"))
+		.def_property_readonly("nballs", &Trajectory::Reader::nballs)
+		.def_property_readonly("nframes", &Trajectory::Reader::nframes)
+		.def_property_readonly("every", &Trajectory::Reader::every)
+		.def_property_readonly("nchunks", [](Trajectory::Reader const& reader) { return reader.chunks().size(); })
+		.def("read", [](Trajectory::Reader const& reader, size_t start, std::optional<size_t> stop) {
+			// frames are decoded straight into the arrays: times (n,), pos and vel (n, nballs, 2)
+			size_t end(stop ? std::min(*stop, reader.nframes()) : reader.nframes());
+			size_t n(end > start ? end - start : 0);
+			std::vector<py::ssize_t> shape{py::ssize_t(n), py::ssize_t(reader.nballs()), 2};
+			py::array_t<double> times(py::ssize_t(n)), pos(shape), vel(shape);
+			double* t(times.mutable_data());
+			vec2* p(reinterpret_cast<vec2*>(pos.mutable_data()));
+			vec2* v(reinterpret_cast<vec2*>(vel.mutable_data()));
+			{
+				py::gil_scoped_release release;
+				reader.read(start, n, t, p, v);
+			}
+			return py::make_tuple(times, pos, vel);
+		}, py::arg("start") = 0, py::arg("stop") = std::nullopt);
+
+	py::module_ m_worldfile = m.def_submodule("worldfile", "binary (memory-mapped) world files");
+	m_worldfile.def("is_world_file", &WorldFile::is_world_file, py::arg("filepath"));
+	m_worldfile.def("save", &WorldFile::save, py::arg("world"), py::arg("filepath"), py::call_guard<py::gil_scoped_release>());
+	m_worldfile.def("load", &WorldFile::load, py::arg("filepath"), py::arg("map") = true, py::call_guard<py::gil_scoped_release>());
+	m_worldfile.def("to_shared_memory", &world_to_shared_memory, py::arg("world"));
+	m_worldfile.def("load_shared", &WorldFile::load_shared, py::arg("name"), py::call_guard<py::gil_scoped_release>());
+
 	py::module_ m_globals = m.def_submodule("constants", "computational constants");
 	m_globals.attr("eps") = Globals::EPS;  // TODO : make readonly
 
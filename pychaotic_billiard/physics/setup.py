@@ -1,11 +1,14 @@
+import sys
 from setuptools import setup
 from pybind11.setup_helpers import Pybind11Extension
 
 ext_modules = [
 	Pybind11Extension(
 		'physics',
-		['../../physics/src/collider.cpp', '../../physics/src/curve.cpp', '../../physics/src/globals.cpp', '../../physics/src/logger.cpp', 'pybind.cpp'],
-		include_dirs=['../../physics/include']
+		['../../physics/src/ball_generator.cpp', '../../physics/src/collider.cpp', '../../physics/src/curve.cpp', '../../physics/src/density.cpp', '../../physics/src/events.cpp', '../../physics/src/globals.cpp', '../../physics/src/json_writer.cpp', '../../physics/src/logger.cpp', '../../physics/src/statistics.cpp', '../../physics/src/trajectory.cpp', '../../physics/src/worldfile.cpp', 'pybind.cpp'],
+		include_dirs=['../../physics/include'],
+		libraries=['rt'] if sys.platform.startswith('linux') else [],  # shm_open before glibc 2.34
+		cxx_std=20
 	)
 ]
 
@@ -1,4 +1,4 @@
-from physics import World, Segment, Ball, vec2
+from physics import World, Segment, Arc, Ball, vec2
 
 w = World()
 w.add_curve(Segment(vec2(2, 1), vec2(2, 4)))
@@ -20,4 +20,197 @@ assert(w.balls[1].pos.x == -16.0)
 assert(w.balls[1].pos.y == -7.0)
 assert(w.balls[1].vel.x == -2.0)
 assert(w.balls[1].vel.y == -1.0)
+
+print('>>> numpy views')
+pos = w.positions  # shares memory with the World
+assert(pos.shape == (2, 2))
+assert(pos[1, 0] == -16.0 and pos[1, 1] == -7.0)
+assert(w.velocities[0, 0] == -2.0 and w.prev_positions.shape == (2, 2))
+w.velocities[0] = (2, 1)  # written in place
+assert(w.balls[0].vel.x == 2.0 and w.balls[0].vel.y == 1.0)
+try:
+	w.add_ball(Ball(vec2(0, 0), vec2(1, 0)))  # would move the storage under `pos`
+	assert(False)
+except BufferError:
+	pass
+del pos
+w.add_ball(Ball(vec2(0, 0), vec2(1, 0)))
+assert(w.positions.shape == (3, 2))
+
+print('>>> bulk construction')
+import numpy as np
+v = World()
+v.add_balls(np.array([[0, 1], [2, 3]]), np.array([[1, 0], [0, 1]]))  # integers are converted
+assert(v.nballs == 2 and v.balls[1].pos.y == 3.0 and v.balls[1].pos_prev.x == 2.0)
+v.set_state(np.zeros((3, 2)), np.ones((3, 2)))
+assert(v.nballs == 3 and v.balls[2].vel.x == 1.0)
+from physics import statistics
+v.statistics = statistics.Collector()
+v.step(0.1)
+v.set_state(np.zeros((2, 2)), np.full((2, 2), 3.0))  # fewer and faster balls
+v.step(0.1)
+v.set_state(np.zeros((4, 2)), np.full((4, 2), 3.0))
+v.set_ball(0, Ball(vec2(0, 0), vec2(0, 1)))
+v.step(0.1)
+v.statistics.merge()
+assert(v.statistics.max_speed_drift == 0)  # measured from the speeds the balls were given
+v.statistics = None
+v.add_segments(np.array([[0, 0], [1, 0]]), np.array([[1, 0], [1, 1]]))
+assert(len(v.curves) == 2 and v.curves[1].p2.y == 1.0)
+
+print('>>> curve dispatch')
+class Wall(Segment):
+	pass
+class Bumpy(Segment):
+	def ortho(self, t):
+		return Segment.ortho(self, t)
+v.add_curve(Wall(vec2(0, 0), vec2(0, 1)))
+v.add_curve(Bumpy(vec2(0, 1), vec2(1, 1)))
+assert(v.curve_paths == ['native', 'native', 'native', 'python (ortho)'])
+class Mirror(Segment):
+	calls = 0
+	def ortho(self, t):
+		Mirror.calls += 1
+		return Segment.ortho(self, t)
+# the step loop must call the override of Mirror, and the C++ implementation of Wall
+paths = []
+for curve in [Segment(vec2(1, -10), vec2(1, 10)), Wall(vec2(1, -10), vec2(1, 10)), Mirror(vec2(1, -10), vec2(1, 10))]:
+	m = World()
+	m.add_curve(curve)
+	m.add_ball(Ball(vec2(0, 0.5), vec2(1, 0.25)))
+	m.step(2)
+	paths.append((m.curve_paths[0], m.balls[0].pos.x, m.balls[0].pos.y, m.balls[0].vel.x, m.balls[0].vel.y))
+assert(Mirror.calls > 0)
+assert([path for path, *_ in paths] == ['native', 'native', 'python (ortho)'])
+assert(paths[0][1:] == paths[1][1:] == paths[2][1:] and paths[0][3] == -1.0)
+
+print('>>> curve arrays')
+s = Segment(vec2(0, 0), vec2(2, 0))
+assert(s.eval(np.array([0, 0.5, 1])).tolist() == [[0, 0], [1, 0], [2, 0]])
+assert(s.eval(np.zeros((2, 3))).shape == (2, 3, 2))
+assert(s.tangent(np.array([0.5]))[0, 0] == s.tangent(0.5).x)
+# arrays of any dtype, even of size 1, take the array path; scalars return a vec2
+assert(s.tangent(np.array([1])).shape == (1, 2) and s.ortho(np.array([1])).shape == (1, 2))
+assert(s.ortho(np.array([1], dtype=np.float32))[0].tolist() == [s.ortho(1).x, s.ortho(1).y])
+assert(isinstance(s.tangent(1), vec2) and isinstance(s.ortho(np.float64(0.5)), vec2))
+assert(s.inverse(np.array([[1, 0], [2, 0]])).tolist() == [0.5, 1.0])
+index, t_curve, t_segment = s.collide(np.array([[[1, -1], [1, 1]], [[0, 1], [2, 1]], [[0.5, -1], [0.5, 1]]]))
+hits = index[(0 <= t_curve) & (t_curve <= 1) & (0 <= t_segment) & (t_segment <= 1)]
+assert(hits.tolist() == [0, 2])
+
+print('>>> bounce batches')
+from physics import events
+e = World()
+e.add_curve(Segment(vec2(1, -10), vec2(1, 10)))
+e.add_balls(np.stack([np.zeros(100), np.linspace(-5, 5, 100)], axis=1), np.tile([1.0, 0.0], (100, 1)))
+batches = []
+e.set_event_sink(events.CallbackSink(batches.append, arrays=True), events.Settings(flush_every_step=True))
+for i in range(20):
+	e.step(0.1)
+	if i == 10:
+		assert(len(batches) == 1 and batches[0].dtype == events.bounce_dtype)
+		assert(len(batches[0]) == 100 and (batches[0]['vel']['x'] == -1).all())
+e.set_event_sink(None)
+
+print('>>> pickling')
+import io, os, pickle
+from physics import worldfile
+e.nthreads = 2
+f = pickle.loads(pickle.dumps(e))
+assert(f.nballs == e.nballs and f.time == e.time and f.nthreads == 2 and len(f.curves) == 1)
+assert((f.positions == e.positions).all() and (f.prev_positions == e.prev_positions).all() and (f.velocities == e.velocities).all())
+shm = worldfile.to_shared_memory(e)
+g = worldfile.load_shared(shm.name)
+g.step(0.1)
+e.step(0.1)
+assert((g.positions == e.positions).all())
+del g
+# attached by name from another process, as the workers of a multiprocessing pool do
+import subprocess, sys
+worker = 'import sys, numpy as np\nfrom physics import worldfile\nw = worldfile.load_shared(sys.argv[1])\nw.step(0.1)\nw.step(0.1)\nnp.save(sys.stdout.buffer, w.positions)'
+child = subprocess.run([sys.executable, '-c', worker, shm.name], capture_output=True, check=True, cwd=os.path.dirname(os.path.abspath(__file__)))
+e.step(0.1)
+assert((np.load(io.BytesIO(child.stdout)) == e.positions).all())
+shm.close()
+shm.unlink()
+print('>>> trajectory round trip')
+import os, tempfile
+from physics import trajectory
+tmp = tempfile.mkdtemp()
+def box_world():
+	b = World()
+	b.add_segments(np.array([[0, 0], [10, 0], [10, 10], [0, 10]]), np.array([[10, 0], [10, 10], [0, 10], [0, 0]]))
+	b.add_curve(Arc(vec2(5, 5), 1, 0, 2*np.pi))
+	rng = np.random.default_rng(1)
+	angles = rng.uniform(0, 2*np.pi, 50)
+	b.add_balls(rng.uniform(1, 3, (50, 2)), np.stack([np.cos(angles), np.sin(angles)], axis=1))
+	return b
+b = box_world()
+recorder = trajectory.Recorder(os.path.join(tmp, 'run.cbt'), trajectory.Settings(every=3, chunk_frames=4))
+b.trajectory = recorder
+expected = []
+for i in range(30):
+	b.step(0.37)
+	if (i + 1) % 3 == 0:
+		expected.append((b.time, b.positions.copy(), b.velocities.copy()))
+recorder.close()
+reader = trajectory.Reader(os.path.join(tmp, 'run.cbt'))
+assert(reader.nframes == 10 and reader.every == 3 and reader.nchunks == 3)
+times, pos, vel = reader.read()
+assert(times.tolist() == [t for t, _, _ in expected])
+assert(all((pos[k] == p).all() and (vel[k] == v).all() for k, (_, p, v) in enumerate(expected)))  # bit-identical
+times, pos, vel = reader.read(start=3, stop=5)  # across the first chunk boundary
+assert(times.tolist() == [expected[3][0], expected[4][0]] and (pos[1] == expected[4][1]).all())
+
+print('>>> bounce file')
+ys = np.linspace(-5, 5, 100)
+d = World()
+d.add_curve(Segment(vec2(1, -10), vec2(1, 10)))
+d.add_balls(np.stack([np.zeros(100), ys], axis=1), np.tile([1.0, 0.0], (100, 1)))
+sink = events.FileSink(os.path.join(tmp, 'run.bin'))
+d.set_event_sink(sink)
+for i in range(20):
+	d.step(0.1)
+d.set_event_sink(None)
+sink.close()
+assert(not sink.failed)
+bounces = np.fromfile(os.path.join(tmp, 'run.bin'), events.bounce_dtype)
+assert(events.bounce_dtype.itemsize == 64 and len(bounces) == 100)
+assert(sorted(bounces['ball'].tolist()) == list(range(100)) and (bounces['curve'] == 0).all())
+assert(np.allclose(bounces['time'], 1) and np.allclose(bounces['t'], (ys[bounces['ball']] + 10)/20))
+assert(np.allclose(bounces['pos']['x'], 1) and np.allclose(bounces['pos']['y'], ys[bounces['ball']]))
+assert((bounces['vel']['x'] == -1).all() and (bounces['vel']['y'] == 0).all())
+
+print('>>> event log reconstruction')
+b = box_world()
+b.set_event_sink(events.LogSink(os.path.join(tmp, 'run.log'), b))
+b.step(0.37)
+t1, pos1 = b.time, b.positions.copy()
+for i in range(40):
+	b.step(0.37)
+b.set_event_sink(None)
+rec = events.Reconstructor(os.path.join(tmp, 'run.log'))
+assert(rec.nballs == 50 and rec.start_time == 0 and rec.nbounces > 0)
+assert(np.allclose(rec.positions(t1), pos1, rtol=0, atol=1e-9))
+assert(np.allclose(rec.positions(b.time), b.positions, rtol=0, atol=1e-9))
+assert(abs(rec.position(7, b.time).x - b.positions[7, 0]) < 1e-9)
+
+print('>>> World.run')
+r, h = box_world(), box_world()
+records = r.run(10, 0.37, record_every=3)
+assert(records['time'].shape == (3,) and records['positions'].shape == (3, 50, 2) and records['velocities'].shape == (3, 50, 2))
+for i in range(10):
+	h.step(0.37)
+	if (i + 1) % 3 == 0:
+		k = (i + 1) // 3 - 1
+		assert(records['time'][k] == h.time)
+		assert((records['positions'][k] == h.positions).all() and (records['velocities'][k] == h.velocities).all())
+assert((r.positions == h.positions).all())  # the 10th step is not recorded, but taken
+assert(r.run(5, 0.37, record_every=0, fields=('positions',))['positions'].shape == (0, 50, 2))
+try:
+	r.run(1, 0.37, fields=('accelerations',))
+	assert(False)
+except ValueError:
+	pass
+
 print('OK')